@@ -0,0 +1,33 @@
+#version 460 core
+layout (location = 0) in vec3 aPos;
+
+// Must match shadowMapping.vert exactly, the lighting pass tests against this depth with GL_EQUAL
+invariant gl_Position;
+
+uniform mat4 projection;
+uniform mat4 view;
+
+struct ObjectData
+{
+    mat4 model;
+    mat4 normalMatrix;
+    uint material;
+};
+
+layout (std430, binding = 1) readonly buffer Objects
+{
+    ObjectData objects[];
+};
+
+// Object index per instance, each draw's instances start at its base instance
+layout (std430, binding = 9) readonly buffer Instances
+{
+    uint instances[];
+};
+
+void main()
+{
+    ObjectData object = objects[instances[gl_BaseInstance + gl_InstanceID]];
+    vec4 worldPos = object.model * vec4(aPos, 1.0);
+    gl_Position = projection * view * worldPos;
+}
\ No newline at end of file
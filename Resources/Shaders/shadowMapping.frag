@@ -1,4 +1,29 @@
-#version 410 core
+#version 460 core
+
+// Set by the renderer from its shadow settings, matches ShadowFilter
+#define SHADOW_FILTER_SINGLE 0
+#define SHADOW_FILTER_GATHER 1
+#define SHADOW_FILTER_POISSON 2
+#ifndef SHADOW_FILTER
+#define SHADOW_FILTER SHADOW_FILTER_POISSON
+#endif
+
+// Matches ShadowTechnique
+#define SHADOW_TECHNIQUE_PCF 0
+#define SHADOW_TECHNIQUE_EVSM 1
+#ifndef SHADOW_TECHNIQUE
+#define SHADOW_TECHNIQUE SHADOW_TECHNIQUE_PCF
+#endif
+
+// Same warp as evsmBlur.comp
+#ifndef SHADOW_MOMENTS_32F
+#define SHADOW_MOMENTS_32F 1
+#endif
+#if SHADOW_MOMENTS_32F
+const vec2 EVSM_EXPONENTS = vec2(40.0, 5.0);
+#else
+const vec2 EVSM_EXPONENTS = vec2(5.54, 5.54);
+#endif
 
 out vec4 FragColor;
 
@@ -6,14 +31,32 @@ in VS_OUT {
     vec3 FragPos;
     vec3 Normal;
     vec2 TexCoords;
+    flat uint Material;
 } fs_in;
 
-uniform sampler2D diffuseTexture;
-uniform sampler2DArray shadowMap;
+struct MaterialData
+{
+    uint array;     // Which array is bound to diffuseTextures is decided per batch on the CPU
+    uint layer;
+    uint flags;
+    uint pad;
+};
+
+const uint MATERIAL_CLAMP = 1u;
+const uint NO_MATERIAL = 0xFFFFFFFFu;
+
+layout (std430, binding = 11) readonly buffer Materials
+{
+    MaterialData materials[];
+};
+
+uniform sampler2DArray diffuseTextures;
+// Compares against the reference depth (GL_TEXTURE_COMPARE_MODE), 1.0 where lit
+uniform sampler2DArrayShadow shadowMap;
+uniform sampler2DArray shadowMoments;   // Only bound with SHADOW_TECHNIQUE_EVSM
 
 uniform vec3 lightDir;
 uniform vec3 viewPos;
-uniform float farPlane;
 
 uniform mat4 view;
 
@@ -22,27 +65,142 @@ layout (std140) uniform LightSpaceMatrices
     mat4 lightSpaceMatrices[16];
 };
 uniform float cascadePlaneDistances[16];
-uniform int cascadeCount;   // number of frusta - 1
 
-float ShadowCalculation(vec3 fragPosWorldSpace)
+// Point and spot lights binned by LightClusters, same grid as CLUSTERS_X/Y/Z
+const uvec3 CLUSTER_GRID = uvec3(16u, 9u, 24u);
+const uint LIGHT_TYPE_SPOT = 1u;
+
+struct LightData
 {
-    // select cascade layer
-    vec4 fragPosViewSpace = view * vec4(fragPosWorldSpace, 1.0);
-    float depthValue = abs(fragPosViewSpace.z);
+    vec4 positionRange;
+    vec4 color;
+    vec4 directionType;
+    vec4 spot;              // x inner cosine, y outer cosine
+};
+
+layout (std430, binding = 13) readonly buffer Lights
+{
+    LightData lights[];
+};
 
-    int layer = -1;
-    for (int i = 0; i < cascadeCount; ++i)
+// Offset and count into lightIndices per cluster
+layout (std430, binding = 14) readonly buffer LightClusters
+{
+    uvec2 clusterRanges[];
+};
+
+layout (std430, binding = 15) readonly buffer LightIndices
+{
+    uint lightIndices[];
+};
+
+uniform vec3 clusterScale;  // Tiles per pixel in xy, slices per log view depth in z
+uniform float clusterBias;
+
+vec3 DiffuseColor()
+{
+    // Same as sampling with no texture bound
+    if (fs_in.Material == NO_MATERIAL)
     {
-        if (depthValue < cascadePlaneDistances[i])
+        return vec3(0.0);
+    }
+    MaterialData material = materials[fs_in.Material];
+    if (material.array == NO_MATERIAL)
+    {
+        return vec3(0.0);
+    }
+
+    // The array repeats, so clamping to the edge texel centers is done here
+    vec2 uv = fs_in.TexCoords;
+    if ((material.flags & MATERIAL_CLAMP) != 0u)
+    {
+        vec2 halfTexel = 0.5 / vec2(textureSize(diffuseTextures, 0).xy);
+        uv = clamp(uv, halfTexel, 1.0 - halfTexel);
+    }
+    return texture(diffuseTextures, vec3(uv, float(material.layer))).rgb;
+}
+
+// Fraction of light reaching the sample, each tap is a hardware compare with bilinear PCF
+float ShadowLit(vec2 uv, float layer, float depth)
+{
+    vec2 size = vec2(textureSize(shadowMap, 0).xy);
+#if SHADOW_FILTER == SHADOW_FILTER_SINGLE
+    return texture(shadowMap, vec4(uv, layer, depth));
+#elif SHADOW_FILTER == SHADOW_FILTER_GATHER
+    // 3x3 tent over the 4x4 texels around the sample, four gathers of 2x2 compares each.
+    // Gather components are (-x, +y), (+x, +y), (+x, -y), (-x, -y)
+    vec2 texel = uv * size - 0.5;
+    vec2 base = floor(texel);
+    vec2 f = texel - base;
+    vec4 wx = vec4(1.0 - f.x, 1.0, 1.0, f.x);
+    vec4 wy = vec4(1.0 - f.y, 1.0, 1.0, f.y);
+
+    float lit = 0.0;
+    for (int y = 0; y < 2; ++y)
+    {
+        for (int x = 0; x < 2; ++x)
         {
-            layer = i;
-            break;
+            vec2 corner = (base + vec2(x, y) * 2.0) / size;
+            vec2 gx = x == 0 ? wx.xy : wx.zw;
+            vec2 gy = y == 0 ? wy.xy : wy.zw;
+            vec4 taps = textureGather(shadowMap, vec3(corner, layer), depth);
+            lit += dot(taps, vec4(gx.x * gy.y, gx.y * gy.y, gx.y * gy.x, gx.x * gy.x));
         }
     }
-    if (layer == -1)
+    return lit / 9.0;
+#else
+    // Disc rotated per pixel so the pattern turns into noise instead of banding
+    const vec2 poissonDisk[12] = vec2[](
+        vec2(-0.326, -0.406), vec2(-0.840, -0.074), vec2(-0.696, 0.457),
+        vec2(-0.203, 0.621), vec2(0.962, -0.195), vec2(0.473, -0.480),
+        vec2(0.519, 0.767), vec2(0.185, -0.893), vec2(0.507, 0.064),
+        vec2(0.896, 0.412), vec2(-0.322, -0.933), vec2(-0.792, -0.598));
+    const float radius = 2.0;
+
+    float angle = 6.283185 * fract(52.982919 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+    mat2 rotation = mat2(cos(angle), sin(angle), -sin(angle), cos(angle)) * (radius / size.x);
+
+    float lit = 0.0;
+    for (int i = 0; i < 12; ++i)
     {
-        layer = cascadeCount;
+        lit += texture(shadowMap, vec4(uv + rotation * poissonDisk[i], layer, depth));
     }
+    return lit / 12.0;
+#endif
+}
+
+// Chebyshev upper bound of one warped moment pair, with the tail cut off against light bleeding
+float ChebyshevLit(vec2 moments, float depth, float minVariance)
+{
+    const float bleedReduction = 0.2;
+    float variance = max(moments.y - moments.x * moments.x, minVariance);
+    float delta = depth - moments.x;
+    float pMax = clamp((variance / (variance + delta * delta) - bleedReduction) / (1.0 - bleedReduction), 0.0, 1.0);
+    return depth <= moments.x ? 1.0 : pMax;
+}
+
+float EvsmLit(vec2 uv, float layer, float depth)
+{
+    float d = depth * 2.0 - 1.0;
+    vec2 warped = vec2(exp(EVSM_EXPONENTS.x * d), -exp(-EVSM_EXPONENTS.y * d));
+    // Variance floor scaled by the warp's slope at this depth
+    vec2 depthScale = 0.0001 * EVSM_EXPONENTS * warped;
+    vec2 minVariance = depthScale * depthScale;
+
+    vec4 moments = texture(shadowMoments, vec3(uv, layer));
+    return min(ChebyshevLit(moments.xy, warped.x, minVariance.x), ChebyshevLit(moments.zw, warped.y, minVariance.y));
+}
+
+float ShadowCalculation(vec3 fragPosWorldSpace)
+{
+    // select cascade layer: the number of splits the fragment is past, unused splits are at FLT_MAX
+    vec4 fragPosViewSpace = view * vec4(fragPosWorldSpace, 1.0);
+    vec4 depthValue = vec4(abs(fragPosViewSpace.z));
+    vec4 passed = vec4(greaterThanEqual(depthValue, vec4(cascadePlaneDistances[0], cascadePlaneDistances[1], cascadePlaneDistances[2], cascadePlaneDistances[3])))
+        + vec4(greaterThanEqual(depthValue, vec4(cascadePlaneDistances[4], cascadePlaneDistances[5], cascadePlaneDistances[6], cascadePlaneDistances[7])))
+        + vec4(greaterThanEqual(depthValue, vec4(cascadePlaneDistances[8], cascadePlaneDistances[9], cascadePlaneDistances[10], cascadePlaneDistances[11])))
+        + vec4(greaterThanEqual(depthValue, vec4(cascadePlaneDistances[12], cascadePlaneDistances[13], cascadePlaneDistances[14], cascadePlaneDistances[15])));
+    int layer = int(dot(passed, vec4(1.0)));
 
     vec4 fragPosLightSpace = lightSpaceMatrices[layer] * vec4(fragPosWorldSpace, 1.0);
     // perform perspective divide
@@ -50,6 +208,14 @@ float ShadowCalculation(vec3 fragPosWorldSpace)
     // transform to [0,1] range
     projCoords = projCoords * 0.5 + 0.5;
 
+    // Cascades past the first are only refit every few frames and can trail the camera,
+    // a fragment that left its cascade falls through to the next one when there is one
+    if (any(greaterThan(abs(projCoords.xy - 0.5), vec2(0.5))) && cascadePlaneDistances[layer] < 3.0e38)
+    {
+        layer += 1;
+        projCoords = (lightSpaceMatrices[layer] * vec4(fragPosWorldSpace, 1.0)).xyz * 0.5 + 0.5;
+    }
+
     // get depth of current fragment from light's perspective
     float currentDepth = projCoords.z;
 
@@ -58,38 +224,60 @@ float ShadowCalculation(vec3 fragPosWorldSpace)
     {
         return 0.0;
     }
-    // calculate bias (based on depth map resolution and slope)
+#if SHADOW_TECHNIQUE == SHADOW_TECHNIQUE_EVSM
+    // The variance floor takes the place of the depth bias
+    return 1.0 - EvsmLit(projCoords.xy, float(layer), currentDepth);
+#else
+    // calculate bias in texels, scaled with the slope. Every cascade's depth range is as
+    // wide as the cascade itself, so a texel is 1 / resolution in depth for all of them
     vec3 normal = normalize(fs_in.Normal);
-    float bias = max(0.05 * (1.0 - dot(normal, lightDir)), 0.005);
-    const float biasModifier = 0.5f;
-    if (layer == cascadeCount)
-    {
-        bias *= 1 / (farPlane * biasModifier);
-    }
-    else
-    {
-        bias *= 1 / (cascadePlaneDistances[layer] * biasModifier);
-    }
+    float cosTheta = clamp(dot(normal, lightDir), 0.05, 1.0);
+    float slope = sqrt(1.0 - cosTheta * cosTheta) / cosTheta;
+    float bias = min(0.5 + 1.5 * slope, 4.0) / float(textureSize(shadowMap, 0).x);
+
+    return 1.0 - ShadowLit(projCoords.xy, float(layer), currentDepth - bias);
+#endif
+}
 
-    // PCF
-    float shadow = 0.0;
-    vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0));
-    for(int x = -1; x <= 1; ++x)
+uint ClusterIndex(float viewDepth)
+{
+    uvec2 tile = min(uvec2(gl_FragCoord.xy * clusterScale.xy), CLUSTER_GRID.xy - 1u);
+    uint slice = uint(clamp(log(viewDepth) * clusterScale.z + clusterBias, 0.0, float(CLUSTER_GRID.z - 1u)));
+    return (slice * CLUSTER_GRID.y + tile.y) * CLUSTER_GRID.x + tile.x;
+}
+
+// Blinn-Phong from the lights in this fragment's cluster, windowed inverse square falloff
+vec3 LocalLights(vec3 normal, vec3 viewDir)
+{
+    float viewDepth = -(view * vec4(fs_in.FragPos, 1.0)).z;
+    uvec2 range = clusterRanges[ClusterIndex(viewDepth)];
+
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < range.y; ++i)
     {
-        for(int y = -1; y <= 1; ++y)
+        LightData light = lights[lightIndices[range.x + i]];
+        vec3 toLight = light.positionRange.xyz - fs_in.FragPos;
+        float distanceSq = dot(toLight, toLight);
+        vec3 L = toLight * inversesqrt(max(distanceSq, 1.0e-8));
+
+        float ratio = distanceSq / (light.positionRange.w * light.positionRange.w);
+        float window = clamp(1.0 - ratio * ratio, 0.0, 1.0);
+        float attenuation = window * window / (distanceSq + 1.0);
+        if (uint(light.directionType.w) == LIGHT_TYPE_SPOT)
         {
-            float pcfDepth = texture(shadowMap, vec3(projCoords.xy + vec2(x, y) * texelSize, layer)).r;
-            shadow += (currentDepth - bias) > pcfDepth ? 1.0 : 0.0;        
-        }    
+            attenuation *= smoothstep(light.spot.y, light.spot.x, dot(-L, light.directionType.xyz));
+        }
+
+        float diff = max(dot(L, normal), 0.0);
+        float spec = pow(max(dot(normal, normalize(L + viewDir)), 0.0), 64.0);
+        result += (diff + spec) * attenuation * light.color.rgb;
     }
-    shadow /= 9.0;
-        
-    return shadow;
+    return result;
 }
 
 void main()
 {           
-    vec3 color = texture(diffuseTexture, fs_in.TexCoords).rgb;
+    vec3 color = DiffuseColor();
     vec3 normal = normalize(fs_in.Normal);
     vec3 lightColor = vec3(0.3);
     // ambient
@@ -106,7 +294,7 @@ void main()
     vec3 specular = spec * lightColor;    
     // calculate shadow
     float shadow = ShadowCalculation(fs_in.FragPos);                      
-    vec3 lighting = (ambient + (1.0 - shadow) * (diffuse + specular)) * color;    
+    vec3 lighting = (ambient + (1.0 - shadow) * (diffuse + specular) + LocalLights(normal, viewDir)) * color;
     
     FragColor = vec4(lighting, 1.0);
 }
@@ -1,4 +1,4 @@
-#version 410 core
+#version 460 core
 
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
@@ -10,16 +10,40 @@ out VS_OUT {
     vec3 FragPos;
     vec3 Normal;
     vec2 TexCoords;
+    flat uint Material;
 } vs_out;
 
+// The depth prepass computes the same position, see depthPrepass.vert
+invariant gl_Position;
+
 uniform mat4 projection;
 uniform mat4 view;
-uniform mat4 model;
+
+struct ObjectData
+{
+    mat4 model;
+    mat4 normalMatrix;
+    uint material;
+};
+
+layout (std430, binding = 1) readonly buffer Objects
+{
+    ObjectData objects[];
+};
+
+// Object index per instance, each draw's instances start at its base instance
+layout (std430, binding = 9) readonly buffer Instances
+{
+    uint instances[];
+};
 
 void main()
 {
-    vs_out.FragPos = vec3(model * vec4(aPos, 1.0));
-    vs_out.Normal = transpose(inverse(mat3(model))) * aNormal;
+    ObjectData object = objects[instances[gl_BaseInstance + gl_InstanceID]];
+    vs_out.Material = object.material;
+    vec4 worldPos = object.model * vec4(aPos, 1.0);
+    vs_out.FragPos = worldPos.xyz;
+    vs_out.Normal = mat3(object.normalMatrix) * aNormal;
     vs_out.TexCoords = aTexCoords;
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = projection * view * worldPos;
 }
\ No newline at end of file
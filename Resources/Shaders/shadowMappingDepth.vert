@@ -1,10 +1,32 @@
-#version 410 core
+#version 460 core
 layout (location = 0) in vec3 aPos;
 
-uniform mat4 model;
+out VS_OUT {
+    flat uint object;
+} vs_out;
+
+struct ObjectData
+{
+    mat4 model;
+    mat4 normalMatrix;
+    uint material;
+};
+
+layout (std430, binding = 1) readonly buffer Objects
+{
+    ObjectData objects[];
+};
+
+// Object index per instance, each draw's instances start at its base instance
+layout (std430, binding = 9) readonly buffer Instances
+{
+    uint instances[];
+};
 
 void main()
 {
-    gl_Position = model * vec4(aPos, 1.0);
+    uint object = instances[gl_BaseInstance + gl_InstanceID];
+    vs_out.object = object;
+    gl_Position = objects[object].model * vec4(aPos, 1.0);
 }
 
@@ -0,0 +1,38 @@
+#version 460 core
+#extension GL_ARB_shader_viewport_layer_array : enable
+#extension GL_AMD_vertex_shader_layer : enable
+layout (location = 0) in vec3 aPos;
+
+layout (std140, binding = 0) uniform LightSpaceMatrices
+{
+    mat4 lightSpaceMatrices[16];
+};
+
+struct ObjectData
+{
+    mat4 model;
+    mat4 normalMatrix;
+    uint material;
+};
+
+layout (std430, binding = 1) readonly buffer Objects
+{
+    ObjectData objects[];
+};
+
+// One instance per object and cascade it overlaps, the cascade is packed above the object index
+layout (std430, binding = 9) readonly buffer Instances
+{
+    uint instances[];
+};
+
+const uint CASCADE_SHIFT = 28u;
+const uint OBJECT_MASK = (1u << CASCADE_SHIFT) - 1u;
+
+void main()
+{
+    uint packed = instances[gl_BaseInstance + gl_InstanceID];
+    uint cascade = packed >> CASCADE_SHIFT;
+    gl_Position = lightSpaceMatrices[cascade] * objects[packed & OBJECT_MASK].model * vec4(aPos, 1.0);
+    gl_Layer = int(cascade);
+}
\ No newline at end of file
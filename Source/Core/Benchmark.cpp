@@ -0,0 +1,173 @@
+#include "Benchmark.h"
+
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <random>
+
+#include "Log/Logger.h"
+#include "Rendering/Culling.h"
+
+bool ParseBenchmarkArgs(int argc, char* argv[], BenchmarkSettings& settings)
+{
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--no-indirect") == 0) {
+			settings.mMultiDrawIndirect = false;
+		}
+		if (std::strcmp(argv[i], "--no-gpu-cull") == 0) {
+			settings.mGpuCulling = false;
+		}
+		if (std::strcmp(argv[i], "--depth-prepass") == 0) {
+			settings.mDepthPrepassTypes = UINT32_MAX;
+		}
+		if (std::strcmp(argv[i], "--gs-cascades") == 0) {
+			settings.mVertexLayer = false;
+		}
+		if (std::strcmp(argv[i], "--no-sdsm") == 0) {
+			settings.mSampleDistribution = false;
+		}
+		if (std::strcmp(argv[i], "--shadow-quality") == 0 && i + 1 < argc) {
+			const char* tiers[] = { "low", "medium", "high", "ultra" };
+			for (int tier = 0; tier < 4; tier++) {
+				if (std::strcmp(argv[i + 1], tiers[tier]) == 0) {
+					settings.mShadowQuality = tier;
+				}
+			}
+			i++;
+		}
+		if (std::strcmp(argv[i], "--lights") == 0 && i + 1 < argc && std::atoi(argv[i + 1]) >= 0) {
+			settings.mLightCount = std::atoi(argv[++i]);
+		}
+		if (std::strcmp(argv[i], "--cascade-interval") == 0 && i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+			settings.mCascadeUpdateInterval = std::atoi(argv[++i]);
+		}
+		if (std::strcmp(argv[i], "--evsm") == 0) {
+			settings.mShadowMoments = true;
+		}
+		if (std::strcmp(argv[i], "--shadow-filter") == 0 && i + 1 < argc) {
+			const char* filters[] = { "single", "gather", "poisson" };
+			for (int filter = 0; filter < 3; filter++) {
+				if (std::strcmp(argv[i + 1], filters[filter]) == 0) {
+					settings.mShadowFilter = filter;
+				}
+			}
+			i++;
+		}
+		if (std::strcmp(argv[i], "--cascades") == 0 && i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+			settings.mCascadeCount = std::atoi(argv[++i]);
+		}
+	}
+
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--cull-benchmark") != 0) {
+			continue;
+		}
+
+		settings.mCullBoxCount = 100000;
+		if (i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+			settings.mCullBoxCount = std::atoi(argv[++i]);
+		}
+		return true;
+	}
+
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--benchmark") != 0) {
+			continue;
+		}
+
+		settings.mObjectCount = 10000;
+		if (i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+			settings.mObjectCount = std::atoi(argv[++i]);
+		}
+		if (i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+			settings.mFrameCount = std::atoi(argv[++i]);
+		}
+		return true;
+	}
+
+	return false;
+}
+
+void FrameTimer::Begin()
+{
+	mStart = Clock::now();
+}
+
+void FrameTimer::End()
+{
+	const double ms = std::chrono::duration<double, std::milli>(Clock::now() - mStart).count();
+
+	mFrameCount++;
+	if (mFrameCount <= sWarmupFrames) {
+		return;
+	}
+
+	if (mMeasuredFrames == 0) {
+		mMinMs = ms;
+		mMaxMs = ms;
+	}
+	mMinMs = std::min(mMinMs, ms);
+	mMaxMs = std::max(mMaxMs, ms);
+	mTotalMs += ms;
+	mMeasuredFrames++;
+}
+
+void FrameTimer::Report(const char* label) const
+{
+	if (mMeasuredFrames == 0) {
+		spdlog::info("BENCHMARK: {}: no frames measured", label);
+		return;
+	}
+
+	spdlog::info("BENCHMARK: {}: {} frames, avg {:.3f} ms, min {:.3f} ms, max {:.3f} ms",
+		label, mMeasuredFrames, mTotalMs / mMeasuredFrames, mMinMs, mMaxMs);
+}
+
+int RunCullBenchmark(unsigned int boxCount)
+{
+	constexpr unsigned int iterations = 500;
+
+	// Fixed seed so runs are comparable, boxes spread around a camera at the origin
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> size(0.5f, 5.0f);
+
+	FrustumCuller culler;
+	culler.Resize(boxCount);
+	for (unsigned int i = 0; i < boxCount; i++) {
+		culler.SetBounds(i, glm::vec3(position(random), position(random), position(random)), glm::vec3(size(random), size(random), size(random)));
+	}
+
+	const glm::mat4 projection = glm::perspective(glm::radians(70.0f), 1280.0f / 720.0f, 0.1f, 500.0f);
+	const glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	const FrustumPlanes planes = ExtractFrustumPlanes(projection * view);
+
+	std::vector<uint32_t> simdVisible;
+	std::vector<uint32_t> scalarVisible;
+	simdVisible.reserve(boxCount);
+	scalarVisible.reserve(boxCount);
+
+	FrameTimer simdTimer;
+	FrameTimer scalarTimer;
+	for (unsigned int i = 0; i < iterations; i++) {
+		simdVisible.clear();
+		simdTimer.Begin();
+		culler.Cull(planes, simdVisible);
+		simdTimer.End();
+
+		scalarVisible.clear();
+		scalarTimer.Begin();
+		culler.CullScalar(planes, scalarVisible);
+		scalarTimer.End();
+	}
+
+	spdlog::info("BENCHMARK: Frustum culling {} boxes, {} visible", boxCount, simdVisible.size());
+	simdTimer.Report(FrustumCuller::GetInstructionSet());
+	scalarTimer.Report("scalar");
+
+	if (simdVisible != scalarVisible) {
+		spdlog::error("BENCHMARK: SIMD and scalar culling disagree ({} vs {} visible)", simdVisible.size(), scalarVisible.size());
+		return -1;
+	}
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <chrono>
+#include <cstdint>
+
+// Set from the command line: [--benchmark [objectCount] [frameCount]] [--no-indirect] [--no-gpu-cull] [--depth-prepass]
+// [--cascades count] [--gs-cascades] [--no-sdsm] [--shadow-quality low|medium|high|ultra]
+// [--shadow-filter single|gather|poisson] [--evsm]
+// [--cascade-interval frames] [--lights count]
+// or --cull-benchmark [boxCount], which runs without a window. The renderer flags also work
+// without --benchmark, which only swaps in the benchmark scene (sized by --lights) and the report
+struct BenchmarkSettings {
+	unsigned int mObjectCount = 0;
+	unsigned int mCullBoxCount = 0;
+	unsigned int mFrameCount = 1000;
+	unsigned int mLightCount = 256;	// Point and spot lights spread over the grid
+	bool mMultiDrawIndirect = true;
+	bool mGpuCulling = true;
+	uint32_t mDepthPrepassTypes = 0;	// ObjectTypeBit mask, --depth-prepass opts every type in
+	int mShadowQuality = -1;	// A ShadowQuality, -1 keeps the renderer defaults
+	unsigned int mCascadeCount = 0;	// Overrides the quality tier's count when set
+	int mShadowFilter = -1;	// A ShadowFilter overriding the tier's kernel, -1 keeps it
+	bool mShadowMoments = false;	// --evsm switches to exponential variance shadow maps
+	unsigned int mCascadeUpdateInterval = 0;	// Overrides the renderer's interval when set, 1 updates every cascade every frame
+	bool mVertexLayer = true;	// --gs-cascades forces the geometry shader path
+	bool mSampleDistribution = true;	// --no-sdsm keeps the cascades over the whole camera range
+
+	bool IsEnabled() const { return mObjectCount > 0; }
+};
+
+bool ParseBenchmarkArgs(int argc, char* argv[], BenchmarkSettings& settings);
+
+// Frustum culls random boxes with the SIMD and scalar paths and logs both timings
+int RunCullBenchmark(unsigned int boxCount);
+
+//---------------------------------------------------------------------------------
+// Accumulates CPU time spent between Begin/End, skips the first few frames
+// (shader compilation, first uploads) and logs min/avg/max when asked to.
+//---------------------------------------------------------------------------------
+class FrameTimer {
+public:
+	void Begin();
+	void End();
+	void Report(const char* label) const;
+
+	unsigned int GetFrameCount() const { return mFrameCount; }
+private:
+	using Clock = std::chrono::high_resolution_clock;
+
+	static constexpr unsigned int sWarmupFrames = 30;
+
+	Clock::time_point mStart;
+	unsigned int mFrameCount = 0;
+	unsigned int mMeasuredFrames = 0;
+	double mTotalMs = 0.0;
+	double mMinMs = 0.0;
+	double mMaxMs = 0.0;
+};
+
+#endif
@@ -1,5 +1,13 @@
 #include "Game.h"
 
 int main(int argc, char* argv[]) {
+	BenchmarkSettings benchmark;
+	ParseBenchmarkArgs(argc, argv, benchmark);
+	if (benchmark.mCullBoxCount > 0) {
+		return RunCullBenchmark(benchmark.mCullBoxCount);
+	}
+	// Renderer flags apply with or without --benchmark, that one only swaps the scene and adds the report
+	gGame.SetBenchmark(benchmark);
+
 	return gGame.Run("Graphics Engine", 1280, 720, true);
 }
\ No newline at end of file
@@ -1,10 +1,12 @@
 #include "Game.h"
 
 #include "Log/Logger.h"
+#include "Core/JobSystem.h"
 #include "Core/Resources.h"
 #include "Event/EventManager.h"
 #include "Input/InputManager.h"
 #include "Rendering/Renderer.h"
+#include "Rendering/RenderSnapshot.h"
 #include "Scene/Scene.h"
 #include "Rendering/Mesh.h"
 #include "Rendering/Shader.h"
@@ -13,6 +15,7 @@
 Game gGame;
 Resources gResources;
 InputManager gInputManager;
+JobSystem gJobSystem;
 Scene gScene;
 RendererData renderData;
 
@@ -23,15 +26,56 @@ int Game::Run(const char* title, int width, int height, bool fullscreen)
 	}
 
 	gInputManager.StartUp();
+	gJobSystem.StartUp();
 
 	glEnable(GL_DEPTH_TEST);
 
 	loadResources();
 
-	CreateScene();
+	if (m_benchmark.IsEnabled()) {
+		CreateBenchmarkScene(m_benchmark.mObjectCount, m_benchmark.mLightCount);
+	}
+	else {
+		CreateScene();
+	}
+
+	// Defaults match the renderer's, so without any flags nothing changes here
+	renderData.mMultiDrawIndirect = m_benchmark.mMultiDrawIndirect;
+	renderData.mGpuCulling = m_benchmark.mGpuCulling;
+	renderData.mDepthPrepassTypes = m_benchmark.mDepthPrepassTypes;
+	if (m_benchmark.mShadowQuality >= 0) {
+		m_shadowQuality = m_benchmark.mShadowQuality;
+		const ShadowSettings shadows = GetShadowQualitySettings(static_cast<ShadowQuality>(m_benchmark.mShadowQuality));
+		renderData.mDepthMapResolution = shadows.mResolution;
+		renderData.mCascadeCount = shadows.mCascadeCount;
+		renderData.mShadowDepthFormat = shadows.mDepthFormat;
+		renderData.mShadowFilter = shadows.mFilter;
+	}
+	if (m_benchmark.mShadowFilter >= 0) {
+		renderData.mShadowFilter = static_cast<ShadowFilter>(m_benchmark.mShadowFilter);
+	}
+	if (m_benchmark.mCascadeUpdateInterval > 0) {
+		renderData.mCascadeUpdateInterval = m_benchmark.mCascadeUpdateInterval;
+	}
+	if (m_benchmark.mShadowMoments) {
+		renderData.mShadowTechnique = SHADOW_TECHNIQUE_EVSM;
+	}
+	if (m_benchmark.mCascadeCount > 0) {
+		renderData.mCascadeCount = m_benchmark.mCascadeCount;
+	}
+	renderData.mVertexLayer = m_benchmark.mVertexLayer;
+	renderData.mSampleDistribution = m_benchmark.mSampleDistribution;
+
 	Renderer::Init();
+	m_shadowSettings = Renderer::GetShadowSettings();
+
+	// Clear color is context state, set once before the render thread takes the context over
+	glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
+	SDL_GL_MakeCurrent(m_window, nullptr);
+	m_renderThread.Start(m_window, m_glContext);
 
 	float lastFrameTime = 0.0f;
+	uint64_t frame = 0;
 	while (!m_quit) {
 		SDL_Event event;
 		while (SDL_PollEvent(&event)) {
@@ -42,10 +86,17 @@ int Game::Run(const char* title, int width, int height, bool fullscreen)
 		float timestep = time - lastFrameTime;
 		lastFrameTime = time;
 
-		glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
+		// Waits while the render thread still has the previous snapshot queued
+		RenderSnapshot& snapshot = m_renderThread.BeginSnapshot();
 
+		m_frameTimer.Begin();
 		UpdateScene(timestep);
-		Renderer::RenderScene();
+		BuildRenderSnapshot(snapshot, frame++);
+		snapshot.mApplyShadowSettings = m_shadowSettingsChanged;
+		snapshot.mShadowSettings = m_shadowSettings;
+		m_shadowSettingsChanged = false;
+		m_renderThread.SubmitSnapshot();
+		m_frameTimer.End();
 
 		//if (gResources.mShaderPrograms["shadow"].Reload()) {
 		//	Renderer::Init();
@@ -54,7 +105,50 @@ int Game::Run(const char* title, int width, int height, bool fullscreen)
 
 		gInputManager.Update();
 
-		SDL_GL_SwapWindow(m_window);
+		if (m_benchmark.IsEnabled() && m_frameTimer.GetFrameCount() >= m_benchmark.mFrameCount) {
+			m_quit = true;
+		}
+	}
+
+	// Also hands the GL context back for the report's readbacks
+	m_renderThread.Stop();
+
+	if (m_benchmark.IsEnabled()) {
+		spdlog::info("BENCHMARK: {} objects, {}", m_benchmark.mObjectCount, renderData.mMultiDrawIndirect ? "multi draw indirect" : "direct draws");
+		spdlog::info("BENCHMARK: {} draw calls for {} meshes per frame", renderData.mStats.mDrawCalls, renderData.mStats.mDrawCommands);
+		spdlog::info("BENCHMARK: {} objects in view, {} shadow caster/cascade pairs (of {})", renderData.mStats.mVisibleObjects,
+			renderData.mStats.mShadowCasters, gScene.objects.size() * renderData.mCascadeCount);
+		spdlog::info("BENCHMARK: static shadow cache {}, {} cascades rebuilt in the last frame",
+			renderData.mStaticShadowCache ? "on" : "off", renderData.mStats.mStaticCascadeRebuilds);
+		spdlog::info("BENCHMARK: {} of {} cascades updated in the last frame, far cascades every {} frames",
+			renderData.mStats.mCascadesUpdated, renderData.mCascadeCount, renderData.mCascadeUpdateInterval);
+		if (renderData.mGpuCulling) {
+			spdlog::info("BENCHMARK: GPU culling kept {} shadow and {} camera instances in the last frame",
+				renderData.mCulling.ReadVisibleCount(Renderer::GetPassRange(RenderPass::RENDER_PASS_SHADOW_STATIC, RenderPass::RENDER_PASS_SHADOW)),
+				renderData.mCulling.ReadVisibleCount(Renderer::GetPassRange(RenderPass::RENDER_PASS_DEPTH_PREPASS, RenderPass::RENDER_PASS_LIGHTING_EQUAL)));
+		}
+		const double pixels = double(renderData.mScreenWidth) * renderData.mScreenHeight;
+		spdlog::info("BENCHMARK: depth prepass {} ({} objects), lighting shaded {} fragments, {:.2f}x overdraw",
+			renderData.mDepthPrepassTypes != 0 ? "on" : "off", renderData.mStats.mPrepassObjects,
+			renderData.mStats.mShadedFragments, renderData.mStats.mShadedFragments / pixels);
+		const ShadowMemoryStats shadowMemory = Renderer::GetShadowMemoryStats();
+		spdlog::info("BENCHMARK: shadow maps {}x{} x {} cascades, {} depth, {:.1f} MB (+{:.1f} MB static cache, +{:.1f} MB EVSM moments)",
+			renderData.mDepthMapResolution, renderData.mDepthMapResolution, renderData.mCascadeCount,
+			GetShadowDepthFormatName(renderData.mShadowDepthFormat), shadowMemory.mShadowMapBytes / (1024.0 * 1024.0),
+			shadowMemory.mStaticCacheBytes / (1024.0 * 1024.0), shadowMemory.mMomentBytes / (1024.0 * 1024.0));
+		spdlog::info("BENCHMARK: sample distribution shadows {}, cascades cover {:.2f} to {:.2f}",
+			renderData.mSampleDistribution ? "on" : "off", renderData.mShadowNear, renderData.mShadowFar);
+		spdlog::info("BENCHMARK: {} lights binned into {} cluster entries, {:.2f} per cluster",
+			renderData.mStats.mLights, renderData.mStats.mLightClusterEntries,
+			double(renderData.mStats.mLightClusterEntries) / LightClusters::CLUSTER_COUNT);
+		const FrameGraphStats& graphStats = renderData.mFrameGraph.GetStats();
+		spdlog::info("BENCHMARK: frame graph ran {} of {} passes, {} transient textures in {} pooled ({:.1f} MB)",
+			graphStats.mPasses - graphStats.mCulledPasses, graphStats.mPasses, graphStats.mTransientTextures,
+			graphStats.mPooledTextures, graphStats.mPooledBytes / (1024.0 * 1024.0));
+		spdlog::info("BENCHMARK: {} GL state changes issued, {} redundant ones filtered in the last frame",
+			renderData.mStats.mStateChanges, renderData.mStats.mRedundantStateChanges);
+		m_frameTimer.Report("Main thread CPU time (update + snapshot)");
+		m_renderThread.GetTimer().Report("Render thread CPU time");
 	}
 
 	shutdown();
@@ -62,6 +156,11 @@ int Game::Run(const char* title, int width, int height, bool fullscreen)
 	return 0;
 }
 
+void Game::SetBenchmark(const BenchmarkSettings& settings)
+{
+	m_benchmark = settings;
+}
+
 bool Game::initialize(const char* title, int width, int height, bool fullscreen)
 {
 	//-----------------------------------------------------------------------------
@@ -110,6 +209,7 @@ bool Game::initialize(const char* title, int width, int height, bool fullscreen)
 
 void Game::shutdown()
 {
+	gJobSystem.ShutDown();
 	SDL_GL_DeleteContext(m_glContext);
 	SDL_DestroyWindow(m_window);
 	SDL_Quit();
@@ -121,11 +221,8 @@ void Game::processSDLEvent(SDL_Event& event)
 	{
 		case SDL_WINDOWEVENT:
 		{
-			if (event.window.event == SDL_WINDOWEVENT_RESIZED) {
-				int newWidth = event.window.data1;
-				int newHeight = event.window.data2;
-				glViewport(0, 0, newWidth, newHeight);
-			}
+			// Viewports are set per pass by the frame graph on the render thread, the
+			// backbuffer only receives the fixed size blit
 			break;
 		}
 		case SDL_QUIT:
@@ -135,6 +232,19 @@ void Game::processSDLEvent(SDL_Event& event)
 		}
 		case SDL_KEYDOWN:
 		{
+			// F5 steps through the shadow quality tiers without restarting
+			if (event.key.keysym.sym == SDLK_F5 && !event.key.repeat) {
+				m_shadowQuality = (m_shadowQuality + 1) % SHADOW_QUALITY_COUNT;
+				const ShadowTechnique technique = m_shadowSettings.mTechnique;
+				m_shadowSettings = GetShadowQualitySettings(static_cast<ShadowQuality>(m_shadowQuality));
+				m_shadowSettings.mTechnique = technique;
+				m_shadowSettingsChanged = true;
+			}
+			// F6 switches between PCF and EVSM shadows
+			if (event.key.keysym.sym == SDLK_F6 && !event.key.repeat) {
+				m_shadowSettings.mTechnique = m_shadowSettings.mTechnique == SHADOW_TECHNIQUE_PCF ? SHADOW_TECHNIQUE_EVSM : SHADOW_TECHNIQUE_PCF;
+				m_shadowSettingsChanged = true;
+			}
 			gEventManager.Fire<KeyPressEvent>(event.key.keysym.sym);
 			break;
 		}
@@ -169,7 +279,16 @@ void Game::processSDLEvent(SDL_Event& event)
 void Game::loadResources() {
 	LoadShaderProgram("default", "Resources/Shaders/default.vert", "Resources/Shaders/default.frag");
 	LoadShaderProgram("shadow", "Resources/Shaders/shadowMapping.vert", "Resources/Shaders/shadowMapping.frag");
+	LoadShaderProgram("prepass", "Resources/Shaders/depthPrepass.vert", "Resources/Shaders/shadowMappingDepth.frag");
 	LoadShaderProgram("depth", "Resources/Shaders/shadowMappingDepth.vert", "Resources/Shaders/shadowMappingDepth.frag", "Resources/Shaders/shadowMappingDepth.geom");
+	if (GLAD_GL_ARB_shader_viewport_layer_array || GLAD_GL_AMD_vertex_shader_layer) {
+		LoadShaderProgram("depthLayered", "Resources/Shaders/shadowMappingDepthLayered.vert", "Resources/Shaders/shadowMappingDepth.frag");
+	}
+	LoadComputeProgram("sceneScatter", "Resources/Shaders/sceneScatter.comp");
+	LoadComputeProgram("cull", "Resources/Shaders/cull.comp");
+	LoadComputeProgram("hiZ", "Resources/Shaders/hiZ.comp");
+	LoadComputeProgram("depthReduce", "Resources/Shaders/depthReduce.comp");
+	LoadComputeProgram("evsmBlur", "Resources/Shaders/evsmBlur.comp");
 	
 	LoadMesh("Resources/Meshes/Maria/Maria J J Ong.dae", "maria");
 	LoadMesh("Resources/Meshes/suzanne.obj", "suzanne");
@@ -177,4 +296,5 @@ void Game::loadResources() {
 
 	LoadTexture("Resources/Textures/wood.png", "wood");
 	LoadTexture("Resources/Textures/brickwall.jpg", "brick");
+	BuildTextureArrays();
 }
\ No newline at end of file
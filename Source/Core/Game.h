@@ -5,11 +5,16 @@
 #include <SDL.h>
 #include <SDL_opengl.h>
 
+#include "Core/Benchmark.h"
+#include "Rendering/Renderer.h"
+#include "Rendering/RenderThread.h"
+
 struct Resources;
 
 class Game {
 public:
 	int Run(const char* title, int width, int height, bool fullscreen);
+	void SetBenchmark(const BenchmarkSettings& settings);
 private:
 	bool initialize(const char* title, int width, int height, bool fullscreen);
 	void shutdown();
@@ -19,6 +24,13 @@ private:
 	bool m_quit = false;
 	SDL_Window* m_window = nullptr;
 	SDL_GLContext m_glContext = nullptr;
+
+	int m_shadowQuality = SHADOW_QUALITY_HIGH;	// ShadowQuality the F5 key last picked, --shadow-quality sets the first one
+	ShadowSettings m_shadowSettings;	// Main thread copy, reaches the renderer through the next snapshot
+	bool m_shadowSettingsChanged = false;
+	BenchmarkSettings m_benchmark;
+	FrameTimer m_frameTimer;
+	RenderThread m_renderThread;
 };
 
 extern Game gGame;
@@ -0,0 +1,100 @@
+#ifndef HANDLE_H
+#define HANDLE_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//---------------------------------------------------------------------------------
+// Generational handle. Index picks the slot in a HandlePool, generation detects
+// handles that outlived the resource they pointed at. Generation 0 is never handed
+// out, so a default constructed handle is always invalid.
+//---------------------------------------------------------------------------------
+template<typename T>
+struct Handle {
+	uint32_t mIndex = 0;
+	uint32_t mGeneration = 0;
+
+	bool IsValid() const { return mGeneration != 0; }
+	bool operator==(const Handle& other) const { return mIndex == other.mIndex && mGeneration == other.mGeneration; }
+	bool operator!=(const Handle& other) const { return !(*this == other); }
+};
+
+template<typename T>
+class HandlePool {
+public:
+	Handle<T> Create(const T& value);
+	void Destroy(Handle<T> handle);
+
+	bool IsAlive(Handle<T> handle) const;
+	T* TryGet(Handle<T> handle);
+	const T* TryGet(Handle<T> handle) const;
+	T& Get(Handle<T> handle);
+	const T& Get(Handle<T> handle) const;
+
+	size_t Size() const { return mSlots.size() - mFreeList.size(); }
+	size_t Capacity() const { return mSlots.size(); }	// One past the highest slot index handed out
+private:
+	std::vector<T> mSlots;
+	std::vector<uint32_t> mGenerations;
+	std::vector<uint32_t> mFreeList;
+};
+
+template<typename T>
+Handle<T> HandlePool<T>::Create(const T& value) {
+	Handle<T> handle;
+	if (!mFreeList.empty()) {
+		handle.mIndex = mFreeList.back();
+		mFreeList.pop_back();
+		mSlots[handle.mIndex] = value;
+	}
+	else {
+		handle.mIndex = static_cast<uint32_t>(mSlots.size());
+		mSlots.push_back(value);
+		mGenerations.push_back(1);
+	}
+	handle.mGeneration = mGenerations[handle.mIndex];
+	return handle;
+}
+
+template<typename T>
+void HandlePool<T>::Destroy(Handle<T> handle) {
+	if (!IsAlive(handle)) {
+		return;
+	}
+
+	// Skip 0 on wrap around so stale handles can never become valid again
+	uint32_t& generation = mGenerations[handle.mIndex];
+	generation = (generation + 1 == 0) ? 1 : generation + 1;
+	mFreeList.push_back(handle.mIndex);
+}
+
+template<typename T>
+bool HandlePool<T>::IsAlive(Handle<T> handle) const {
+	return handle.mIndex < mGenerations.size() && mGenerations[handle.mIndex] == handle.mGeneration;
+}
+
+template<typename T>
+T* HandlePool<T>::TryGet(Handle<T> handle) {
+	return IsAlive(handle) ? &mSlots[handle.mIndex] : nullptr;
+}
+
+template<typename T>
+const T* HandlePool<T>::TryGet(Handle<T> handle) const {
+	return IsAlive(handle) ? &mSlots[handle.mIndex] : nullptr;
+}
+
+template<typename T>
+T& HandlePool<T>::Get(Handle<T> handle) {
+	assert(IsAlive(handle));
+	return mSlots[handle.mIndex];
+}
+
+template<typename T>
+const T& HandlePool<T>::Get(Handle<T> handle) const {
+	assert(IsAlive(handle));
+	return mSlots[handle.mIndex];
+}
+
+#endif
@@ -0,0 +1,111 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+#include "Log/Logger.h"
+
+void JobSystem::StartUp(unsigned int workerCount)
+{
+	if (workerCount == 0) {
+		workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+	}
+
+	mQuit = false;
+	for (unsigned int i = 0; i < workerCount; i++) {
+		mWorkers.emplace_back(&JobSystem::workerLoop, this);
+	}
+	spdlog::info("JOBSYSTEM::STARTUP: {} worker threads", workerCount);
+}
+
+void JobSystem::ShutDown()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQuit = true;
+	}
+	mWake.notify_all();
+	for (std::thread& worker : mWorkers) {
+		worker.join();
+	}
+	mWorkers.clear();
+}
+
+void JobSystem::ParallelFor(uint32_t count, uint32_t batchSize, const Job& job)
+{
+	if (count == 0) {
+		return;
+	}
+
+	batchSize = std::max(1u, batchSize);
+	const uint32_t batches = (count + batchSize - 1) / batchSize;
+	if (mWorkers.empty() || batches == 1) {
+		job(0, count);
+		return;
+	}
+
+	Loop loop;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mGeneration++;
+		loop.mJob = &job;
+		loop.mCount = count;
+		loop.mBatchSize = batchSize;
+		loop.mGeneration = mGeneration;
+		mLoop = loop;
+		mPendingBatches = batches;
+		mNextBatch = uint64_t(mGeneration) << 32;
+	}
+	mWake.notify_all();
+
+	while (runBatch(loop)) {
+	}
+
+	std::unique_lock<std::mutex> lock(mMutex);
+	mDone.wait(lock, [this] { return mPendingBatches.load() == 0; });
+	mLoop.mJob = nullptr;
+}
+
+void JobSystem::workerLoop()
+{
+	uint32_t generation = 0;
+	for (;;) {
+		Loop loop;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWake.wait(lock, [this, generation] { return mQuit || mGeneration != generation; });
+			if (mQuit) {
+				return;
+			}
+			generation = mGeneration;
+			loop = mLoop;
+		}
+
+		while (runBatch(loop)) {
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// A claim only succeeds while the counter still carries this loop's generation.
+// Once the next ParallelFor has reset it, a late worker fails the compare and
+// goes back to sleep instead of running a batch with the old loop's job.
+//-----------------------------------------------------------------------------
+bool JobSystem::runBatch(const Loop& loop)
+{
+	const uint64_t generation = uint64_t(loop.mGeneration) << 32;
+	const uint32_t batches = (loop.mCount + loop.mBatchSize - 1) / loop.mBatchSize;
+	uint64_t claim = mNextBatch.load();
+	do {
+		if ((claim & ~uint64_t(UINT32_MAX)) != generation || uint32_t(claim) >= batches) {
+			return false;
+		}
+	} while (!mNextBatch.compare_exchange_weak(claim, claim + 1));
+
+	const uint64_t begin = uint64_t(uint32_t(claim)) * loop.mBatchSize;
+	(*loop.mJob)(uint32_t(begin), uint32_t(std::min<uint64_t>(begin + loop.mBatchSize, loop.mCount)));
+	if (mPendingBatches.fetch_sub(1) == 1) {
+		std::lock_guard<std::mutex> lock(mMutex);
+		mDone.notify_all();
+	}
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//---------------------------------------------------------------------------------
+// Fixed pool of worker threads for data parallel loops. ParallelFor splits a
+// range into batches that the workers and the calling thread claim from an
+// atomic counter, and returns once every batch ran. Only one loop runs at a
+// time and it has to be started from the same thread. Claims carry the loop's
+// generation, so a worker still spinning on a finished loop can never take a
+// batch of the next one.
+//---------------------------------------------------------------------------------
+class JobSystem {
+public:
+	using Job = std::function<void(uint32_t begin, uint32_t end)>;
+
+	// 0 workers picks one less than the hardware threads, the caller is the last one
+	void StartUp(unsigned int workerCount = 0);
+	void ShutDown();
+
+	void ParallelFor(uint32_t count, uint32_t batchSize, const Job& job);
+
+	unsigned int GetThreadCount() const { return static_cast<unsigned int>(mWorkers.size()) + 1; }
+private:
+	// Copied under mMutex when a loop starts, workers never read the members directly
+	struct Loop {
+		const Job* mJob = nullptr;
+		uint32_t mCount = 0;
+		uint32_t mBatchSize = 1;
+		uint32_t mGeneration = 0;
+	};
+
+	void workerLoop();
+	bool runBatch(const Loop& loop);
+
+	std::vector<std::thread> mWorkers;
+	std::mutex mMutex;
+	std::condition_variable mWake;
+	std::condition_variable mDone;
+	uint32_t mGeneration = 0;	// Bumped for every loop so sleeping workers know there is work
+	bool mQuit = false;
+
+	Loop mLoop;
+	std::atomic<uint64_t> mNextBatch{ 0 };	// Generation in the high 32 bits, next batch in the low ones
+	std::atomic<uint32_t> mPendingBatches{ 0 };
+};
+
+extern JobSystem gJobSystem;
+
+#endif
\ No newline at end of file
@@ -3,15 +3,34 @@
 
 #include <string>
 #include <map>
+#include <vector>
+
+#include "Core/Handle.h"
+#include "Rendering/GeometryBuffer.h"
 
 struct Mesh;
 struct ShaderProgram;
 struct Texture;
+struct DrawRecord;
+struct GpuMesh;
+struct GpuTexture;
+struct TextureArray;
 
 struct Resources {
 	std::map<std::string, Mesh> mMeshes;
 	std::map<std::string, ShaderProgram> mShaderPrograms;
 	std::map<std::string, Texture> mTextures;
+
+	// Render side view of the above. Names are resolved to handles once, the draw loop only uses these
+	HandlePool<GpuMesh> mGpuMeshes;
+	HandlePool<GpuTexture> mGpuTextures;
+	std::vector<DrawRecord> mDrawRecords;
+	GeometryBuffer mGeometry; // Vertex and index data of every mesh
+	std::map<std::string, Handle<GpuMesh>> mMeshHandles;
+	std::map<std::string, Handle<GpuTexture>> mTextureHandles;
+	std::vector<TextureArray> mTextureArrays;
+	unsigned int mMaterialBuffer = 0; // MaterialData per GpuTexture slot
+	std::vector<ShaderProgram*> mProgramTable; // Indexed by ShaderProgram::mIndex
 };
 
 extern Resources gResources;
@@ -0,0 +1,27 @@
+#ifndef BINDINGS_H
+#define BINDINGS_H
+
+// Buffer binding points, shared with the layout(binding = N) declarations in Resources/Shaders
+enum BufferBinding : unsigned int {
+	// Uniform buffers
+	BINDING_LIGHT_SPACE_MATRICES = 0,
+
+	// Shader storage buffers
+	BINDING_OBJECTS = 1,
+	BINDING_OBJECT_UPDATES = 2,
+	BINDING_DRAW_COMMANDS = 3,
+	BINDING_CULLED_COMMANDS = 4,
+	BINDING_INSTANCE_INFO = 5,
+	BINDING_INSTANCE_COUNTS = 6,
+	BINDING_RECORD_BOUNDS = 7,
+	BINDING_CASCADE_MASKS = 8,
+	BINDING_INSTANCES = 9,
+	BINDING_CULLED_INSTANCES = 10,
+	BINDING_MATERIALS = 11,
+	BINDING_DEPTH_BOUNDS = 12,
+	BINDING_LIGHTS = 13,
+	BINDING_LIGHT_CLUSTERS = 14,
+	BINDING_LIGHT_INDICES = 15
+};
+
+#endif
@@ -0,0 +1,171 @@
+#include "Culling.h"
+
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define CULLING_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CULLING_SSE
+#endif
+
+void TransformBounds(const glm::mat4& transform, const glm::vec3& boundsMin, const glm::vec3& boundsMax, glm::vec3& center, glm::vec3& extents)
+{
+	const glm::vec3 localCenter = (boundsMin + boundsMax) * 0.5f;
+	const glm::vec3 localExtents = (boundsMax - boundsMin) * 0.5f;
+	const glm::mat3 linear(transform);
+
+	center = glm::vec3(transform * glm::vec4(localCenter, 1.0f));
+	extents = glm::vec3(
+		std::abs(linear[0][0]) * localExtents.x + std::abs(linear[1][0]) * localExtents.y + std::abs(linear[2][0]) * localExtents.z,
+		std::abs(linear[0][1]) * localExtents.x + std::abs(linear[1][1]) * localExtents.y + std::abs(linear[2][1]) * localExtents.z,
+		std::abs(linear[0][2]) * localExtents.x + std::abs(linear[1][2]) * localExtents.y + std::abs(linear[2][2]) * localExtents.z);
+}
+
+void FrustumCuller::Resize(size_t count)
+{
+	const size_t padded = (count + PADDING - 1) / PADDING * PADDING;
+	mCenterX.resize(padded);
+	mCenterY.resize(padded);
+	mCenterZ.resize(padded);
+	mExtentX.resize(padded);
+	mExtentY.resize(padded);
+	mExtentZ.resize(padded);
+	mCount = count;
+}
+
+void FrustumCuller::SetBounds(size_t index, const glm::vec3& center, const glm::vec3& extents)
+{
+	mCenterX[index] = center.x;
+	mCenterY[index] = center.y;
+	mCenterZ[index] = center.z;
+	mExtentX[index] = extents.x;
+	mExtentY[index] = extents.y;
+	mExtentZ[index] = extents.z;
+}
+
+const char* FrustumCuller::GetInstructionSet()
+{
+#if defined(CULLING_AVX)
+	return "AVX";
+#elif defined(CULLING_SSE)
+	return "SSE";
+#else
+	return "scalar";
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// A box is outside a plane when even its corner furthest along the normal is
+// behind it: dot(n, c) + w + dot(|n|, e) < 0.
+//-----------------------------------------------------------------------------
+void FrustumCuller::CullScalar(const FrustumPlanes& planes, std::vector<uint32_t>& visible) const
+{
+	for (size_t i = 0; i < mCount; i++) {
+		bool inside = true;
+		for (const glm::vec4& plane : planes) {
+			const float distance = plane.x * mCenterX[i] + plane.y * mCenterY[i] + plane.z * mCenterZ[i] + plane.w;
+			const float radius = std::abs(plane.x) * mExtentX[i] + std::abs(plane.y) * mExtentY[i] + std::abs(plane.z) * mExtentZ[i];
+			if (distance + radius < 0.0f) {
+				inside = false;
+				break;
+			}
+		}
+		if (inside) {
+			visible.push_back(static_cast<uint32_t>(i));
+		}
+	}
+}
+
+#if defined(CULLING_AVX)
+void FrustumCuller::Cull(const FrustumPlanes& planes, std::vector<uint32_t>& visible) const
+{
+	__m256 normalX[6], normalY[6], normalZ[6], absX[6], absY[6], absZ[6], offset[6];
+	for (int p = 0; p < 6; p++) {
+		normalX[p] = _mm256_set1_ps(planes[p].x);
+		normalY[p] = _mm256_set1_ps(planes[p].y);
+		normalZ[p] = _mm256_set1_ps(planes[p].z);
+		absX[p] = _mm256_set1_ps(std::abs(planes[p].x));
+		absY[p] = _mm256_set1_ps(std::abs(planes[p].y));
+		absZ[p] = _mm256_set1_ps(std::abs(planes[p].z));
+		offset[p] = _mm256_set1_ps(planes[p].w);
+	}
+	const __m256 zero = _mm256_setzero_ps();
+
+	for (size_t i = 0; i < mCount; i += 8) {
+		const __m256 centerX = _mm256_loadu_ps(&mCenterX[i]);
+		const __m256 centerY = _mm256_loadu_ps(&mCenterY[i]);
+		const __m256 centerZ = _mm256_loadu_ps(&mCenterZ[i]);
+		const __m256 extentX = _mm256_loadu_ps(&mExtentX[i]);
+		const __m256 extentY = _mm256_loadu_ps(&mExtentY[i]);
+		const __m256 extentZ = _mm256_loadu_ps(&mExtentZ[i]);
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; p++) {
+			// Same summation order as CullScalar, so both round boxes touching a plane alike
+			__m256 distance = _mm256_add_ps(_mm256_mul_ps(normalX[p], centerX), _mm256_mul_ps(normalY[p], centerY));
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(normalZ[p], centerZ));
+			distance = _mm256_add_ps(distance, offset[p]);
+			__m256 radius = _mm256_mul_ps(absX[p], extentX);
+			radius = _mm256_add_ps(radius, _mm256_mul_ps(absY[p], extentY));
+			radius = _mm256_add_ps(radius, _mm256_mul_ps(absZ[p], extentZ));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_GE_OQ));
+		}
+
+		const int mask = _mm256_movemask_ps(inside);
+		for (int lane = 0; lane < 8; lane++) {
+			if ((mask & (1 << lane)) && i + lane < mCount) {
+				visible.push_back(static_cast<uint32_t>(i + lane));
+			}
+		}
+	}
+}
+#elif defined(CULLING_SSE)
+void FrustumCuller::Cull(const FrustumPlanes& planes, std::vector<uint32_t>& visible) const
+{
+	__m128 normalX[6], normalY[6], normalZ[6], absX[6], absY[6], absZ[6], offset[6];
+	for (int p = 0; p < 6; p++) {
+		normalX[p] = _mm_set1_ps(planes[p].x);
+		normalY[p] = _mm_set1_ps(planes[p].y);
+		normalZ[p] = _mm_set1_ps(planes[p].z);
+		absX[p] = _mm_set1_ps(std::abs(planes[p].x));
+		absY[p] = _mm_set1_ps(std::abs(planes[p].y));
+		absZ[p] = _mm_set1_ps(std::abs(planes[p].z));
+		offset[p] = _mm_set1_ps(planes[p].w);
+	}
+	const __m128 zero = _mm_setzero_ps();
+
+	for (size_t i = 0; i < mCount; i += 4) {
+		const __m128 centerX = _mm_loadu_ps(&mCenterX[i]);
+		const __m128 centerY = _mm_loadu_ps(&mCenterY[i]);
+		const __m128 centerZ = _mm_loadu_ps(&mCenterZ[i]);
+		const __m128 extentX = _mm_loadu_ps(&mExtentX[i]);
+		const __m128 extentY = _mm_loadu_ps(&mExtentY[i]);
+		const __m128 extentZ = _mm_loadu_ps(&mExtentZ[i]);
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; p++) {
+			__m128 distance = _mm_add_ps(_mm_mul_ps(normalX[p], centerX), _mm_mul_ps(normalY[p], centerY));
+			distance = _mm_add_ps(distance, _mm_mul_ps(normalZ[p], centerZ));
+			distance = _mm_add_ps(distance, offset[p]);
+			__m128 radius = _mm_mul_ps(absX[p], extentX);
+			radius = _mm_add_ps(radius, _mm_mul_ps(absY[p], extentY));
+			radius = _mm_add_ps(radius, _mm_mul_ps(absZ[p], extentZ));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+		}
+
+		const int mask = _mm_movemask_ps(inside);
+		for (int lane = 0; lane < 4; lane++) {
+			if ((mask & (1 << lane)) && i + lane < mCount) {
+				visible.push_back(static_cast<uint32_t>(i + lane));
+			}
+		}
+	}
+}
+#else
+void FrustumCuller::Cull(const FrustumPlanes& planes, std::vector<uint32_t>& visible) const
+{
+	CullScalar(planes, visible);
+}
+#endif
@@ -0,0 +1,42 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Core/Math.h"
+#include "Scene/Camera.h"
+
+// World space AABB of a local box under an affine transform, as center/extents
+void TransformBounds(const glm::mat4& transform, const glm::vec3& boundsMin, const glm::vec3& boundsMax, glm::vec3& center, glm::vec3& extents);
+
+//---------------------------------------------------------------------------------
+// World space boxes stored as structure of arrays so the plane tests run on
+// 8 (AVX) or 4 (SSE) boxes per instruction. Arrays are padded to a multiple of
+// 8 so the vector loops never need a scalar tail.
+//---------------------------------------------------------------------------------
+class FrustumCuller {
+public:
+	static constexpr size_t PADDING = 8;
+
+	void Resize(size_t count);
+	void SetBounds(size_t index, const glm::vec3& center, const glm::vec3& extents);
+
+	// Appends the indices of boxes at least partly inside all six planes, in ascending order
+	void Cull(const FrustumPlanes& planes, std::vector<uint32_t>& visible) const;
+	void CullScalar(const FrustumPlanes& planes, std::vector<uint32_t>& visible) const;
+
+	size_t Size() const { return mCount; }
+	static const char* GetInstructionSet();
+private:
+	size_t mCount = 0;
+	std::vector<float> mCenterX;
+	std::vector<float> mCenterY;
+	std::vector<float> mCenterZ;
+	std::vector<float> mExtentX;
+	std::vector<float> mExtentY;
+	std::vector<float> mExtentZ;
+};
+
+#endif
@@ -0,0 +1,105 @@
+#include "DepthReduction.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Log/Logger.h"
+#include "Core/Resources.h"
+#include "Rendering/Bindings.h"
+#include "Rendering/GLState.h"
+
+static constexpr uint32_t REDUCE_GROUP_SIZE = 16;
+
+void DepthReduction::Init()
+{
+	mReduceProgram = &gResources.mShaderPrograms.at("depthReduce");
+	mNearPlaneUniform = mReduceProgram->GetUniform<float>("nearPlane");
+	mFarPlaneUniform = mReduceProgram->GetUniform<float>("farPlane");
+
+	GLint alignment = 0;
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	mRegionStride = std::max<GLsizeiptr>(alignment, 2 * sizeof(uint32_t));
+
+	const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	const GLsizeiptr size = mRegionStride * FRAMES_IN_FLIGHT;
+
+	glGenBuffers(1, &mBoundsBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mBoundsBuffer);
+	glBufferStorage(GL_SHADER_STORAGE_BUFFER, size, nullptr, flags);
+	mBoundsData = static_cast<const uint8_t*>(glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, size, flags));
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	if (!mBoundsData) {
+		spdlog::error("DEPTHREDUCTION::INIT: Failed to map {} bytes", size);
+	}
+}
+
+void DepthReduction::Reduce(GLuint depthTexture, unsigned int width, unsigned int height, float nearPlane, float farPlane)
+{
+	if (!mBoundsData) {
+		return;
+	}
+
+	// Only waits when the GPU is FRAMES_IN_FLIGHT frames behind
+	waitForRegion(mRegion);
+
+	const GLintptr offset = GLintptr(mRegion) * mRegionStride;
+	const uint32_t clearValue[2] = { UINT32_MAX, 0 };
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mBoundsBuffer);
+	glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_RG32UI, offset, 2 * sizeof(uint32_t), GL_RG_INTEGER, GL_UNSIGNED_INT, clearValue);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	gGLState.BindBufferRange(GL_SHADER_STORAGE_BUFFER, BINDING_DEPTH_BOUNDS, mBoundsBuffer, offset, 2 * sizeof(uint32_t));
+
+	gGLState.UseProgram(mReduceProgram->mId);
+	mReduceProgram->Set(mNearPlaneUniform, nearPlane);
+	mReduceProgram->Set(mFarPlaneUniform, farPlane);
+	gGLState.BindTexture(0, GL_TEXTURE_2D, depthTexture);
+	glDispatchCompute((width + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE, (height + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE, 1);
+	glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+
+	mFences[mRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	mRegion = (mRegion + 1) % FRAMES_IN_FLIGHT;
+}
+
+bool DepthReduction::Resolve(float& nearDepth, float& farDepth)
+{
+	// Oldest first, the first region still in flight means every newer one is too
+	bool resolved = false;
+	for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
+		const uint32_t region = (mRegion + i) % FRAMES_IN_FLIGHT;
+		if (!mFences[region]) {
+			continue;
+		}
+
+		const GLenum result = glClientWaitSync(mFences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) {
+			break;
+		}
+		glDeleteSync(mFences[region]);
+		mFences[region] = nullptr;
+
+		float bounds[2];
+		std::memcpy(bounds, mBoundsData + GLintptr(region) * mRegionStride, sizeof(bounds));
+		// Nothing drawn leaves the farthest depth below the nearest
+		if (bounds[1] >= bounds[0]) {
+			nearDepth = bounds[0];
+			farDepth = bounds[1];
+			resolved = true;
+		}
+	}
+	return resolved;
+}
+
+void DepthReduction::waitForRegion(uint32_t region)
+{
+	if (!mFences[region]) {
+		return;
+	}
+
+	GLenum result = glClientWaitSync(mFences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	while (result == GL_TIMEOUT_EXPIRED) {
+		result = glClientWaitSync(mFences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+	}
+	glDeleteSync(mFences[region]);
+	mFences[region] = nullptr;
+}
\ No newline at end of file
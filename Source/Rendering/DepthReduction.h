@@ -0,0 +1,41 @@
+#ifndef DEPTH_REDUCTION_H
+#define DEPTH_REDUCTION_H
+
+#include <cstdint>
+
+#include <glad/glad.h>
+
+#include "Rendering/Shader.h"
+
+//---------------------------------------------------------------------------------
+// Finds the nearest and farthest view depth the camera actually drew with a
+// compute reduction over the scene depth buffer (sample distribution shadow
+// maps). Results land in a persistently mapped ring and are picked up once
+// their fence has passed, normally a frame later, so reading never stalls.
+//---------------------------------------------------------------------------------
+class DepthReduction {
+public:
+	static constexpr uint32_t FRAMES_IN_FLIGHT = 3;
+
+	void Init();
+
+	// Queues the reduction of a depth texture rendered with the given camera planes
+	void Reduce(GLuint depthTexture, unsigned int width, unsigned int height, float nearPlane, float farPlane);
+
+	// Newest finished result, false while none came back or the camera saw no geometry
+	bool Resolve(float& nearDepth, float& farDepth);
+private:
+	void waitForRegion(uint32_t region);
+
+	ShaderProgram* mReduceProgram = nullptr;
+	UniformHandle<float> mNearPlaneUniform;
+	UniformHandle<float> mFarPlaneUniform;
+
+	GLuint mBoundsBuffer = 0;
+	const uint8_t* mBoundsData = nullptr;
+	GLsizeiptr mRegionStride = 0;	// Two uints, padded to the storage buffer offset alignment
+	uint32_t mRegion = 0;	// Next region written, also the oldest one in flight
+	GLsync mFences[FRAMES_IN_FLIGHT] = {};
+};
+
+#endif
\ No newline at end of file
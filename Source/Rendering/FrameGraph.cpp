@@ -0,0 +1,351 @@
+#include "FrameGraph.h"
+
+#include <algorithm>
+
+#include "Log/Logger.h"
+#include "Rendering/GLState.h"
+
+static uint64_t texelBytes(GLenum internalFormat)
+{
+	switch (internalFormat) {
+	case GL_DEPTH_COMPONENT16: return 2;
+	case GL_RGBA16F: return 8;
+	case GL_RGBA32F: return 16;
+	default: return 4;
+	}
+}
+
+FrameGraphTexture FrameGraphBuilder::Create(const char* name, const FrameGraphTextureDesc& desc)
+{
+	FrameGraph::TextureNode texture;
+	texture.mName = name;
+	texture.mDesc = desc;
+	mGraph.mTextures.push_back(texture);
+	mGraph.mStats.mTransientTextures++;
+	return static_cast<FrameGraphTexture>(mGraph.mTextures.size() - 1);
+}
+
+void FrameGraphBuilder::Read(FrameGraphTexture texture)
+{
+	mGraph.mPasses[mPass].mReads.push_back(texture);
+}
+
+void FrameGraphBuilder::Write(FrameGraphTexture texture)
+{
+	mGraph.mPasses[mPass].mWrites.push_back(texture);
+}
+
+void FrameGraphBuilder::WriteImage(FrameGraphTexture texture)
+{
+	Write(texture);
+	mGraph.mPasses[mPass].mImageWrites.push_back(texture);
+}
+
+void FrameGraphBuilder::WriteColor(FrameGraphTexture texture, bool clear)
+{
+	Write(texture);
+	mGraph.mPasses[mPass].mColor = texture;
+	mGraph.mPasses[mPass].mClearColor = clear;
+}
+
+void FrameGraphBuilder::WriteDepth(FrameGraphTexture texture, bool clear)
+{
+	Write(texture);
+	mGraph.mPasses[mPass].mDepth = texture;
+	mGraph.mPasses[mPass].mClearDepth = clear;
+}
+
+void FrameGraphBuilder::SideEffect()
+{
+	mGraph.mPasses[mPass].mSideEffect = true;
+}
+
+void FrameGraph::Reset()
+{
+	mTextures.clear();
+	mPasses.clear();
+	mStats = FrameGraphStats();
+}
+
+FrameGraphTexture FrameGraph::Import(const char* name, GLuint texture, const FrameGraphTextureDesc& desc)
+{
+	TextureNode node;
+	node.mName = name;
+	node.mDesc = desc;
+	node.mTexture = texture;
+	node.mImported = true;
+	mTextures.push_back(node);
+	return static_cast<FrameGraphTexture>(mTextures.size() - 1);
+}
+
+FrameGraphBuilder FrameGraph::AddPass(const char* name, Execute execute)
+{
+	PassNode pass;
+	pass.mName = name;
+	pass.mExecute = std::move(execute);
+	mPasses.push_back(std::move(pass));
+	mStats.mPasses++;
+	return FrameGraphBuilder(*this, static_cast<uint32_t>(mPasses.size() - 1));
+}
+
+//-----------------------------------------------------------------------------
+// A pass is needed when it has a side effect or writes a texture a needed
+// pass reads. Starting from the textures nobody reads, every writer loses a
+// reference, and a writer left without any is culled, which in turn releases
+// the textures it read.
+//-----------------------------------------------------------------------------
+void FrameGraph::cull()
+{
+	for (TextureNode& texture : mTextures) {
+		texture.mReaders = 0;
+	}
+	for (PassNode& pass : mPasses) {
+		pass.mRefCount = static_cast<uint32_t>(pass.mWrites.size());
+		pass.mCulled = false;
+		for (FrameGraphTexture texture : pass.mReads) {
+			mTextures[texture].mReaders++;
+		}
+	}
+
+	std::vector<FrameGraphTexture> unused;
+	for (FrameGraphTexture texture = 0; texture < mTextures.size(); texture++) {
+		if (mTextures[texture].mReaders == 0) {
+			unused.push_back(texture);
+		}
+	}
+
+	while (!unused.empty()) {
+		const FrameGraphTexture texture = unused.back();
+		unused.pop_back();
+		for (PassNode& pass : mPasses) {
+			if (pass.mCulled || std::find(pass.mWrites.begin(), pass.mWrites.end(), texture) == pass.mWrites.end()) {
+				continue;
+			}
+			if (--pass.mRefCount > 0 || pass.mSideEffect) {
+				continue;
+			}
+
+			pass.mCulled = true;
+			mStats.mCulledPasses++;
+			for (FrameGraphTexture read : pass.mReads) {
+				if (--mTextures[read].mReaders == 0) {
+					unused.push_back(read);
+				}
+			}
+		}
+	}
+
+	// Passes that write nothing are only kept for their side effects
+	for (PassNode& pass : mPasses) {
+		if (!pass.mCulled && pass.mWrites.empty() && !pass.mSideEffect) {
+			pass.mCulled = true;
+			mStats.mCulledPasses++;
+		}
+	}
+}
+
+void FrameGraph::computeLifetimes()
+{
+	for (uint32_t index = 0; index < mPasses.size(); index++) {
+		const PassNode& pass = mPasses[index];
+		if (pass.mCulled) {
+			continue;
+		}
+
+		auto touch = [this, index](FrameGraphTexture texture) {
+			TextureNode& node = mTextures[texture];
+			if (node.mFirstPass == NO_PASS) {
+				node.mFirstPass = index;
+			}
+			node.mLastPass = index;
+		};
+		for (FrameGraphTexture texture : pass.mReads) {
+			if (!mTextures[texture].mImported && mTextures[texture].mFirstPass == NO_PASS) {
+				spdlog::error("FRAMEGRAPH::COMPILE: Pass {} reads {} before any pass wrote it", pass.mName, mTextures[texture].mName);
+			}
+			touch(texture);
+		}
+		for (FrameGraphTexture texture : pass.mWrites) {
+			touch(texture);
+		}
+	}
+}
+
+void FrameGraph::acquire(TextureNode& texture)
+{
+	const FrameGraphTextureDesc& desc = texture.mDesc;
+	for (uint32_t i = 0; i < mPool.size(); i++) {
+		if (!mPool[i].mInUse && mPool[i].mDesc == desc) {
+			texture.mPoolIndex = i;
+			break;
+		}
+	}
+
+	if (texture.mPoolIndex == UINT32_MAX) {
+		PooledTexture pooled;
+		pooled.mDesc = desc;
+		const GLenum target = desc.mLayers > 0 ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+		glGenTextures(1, &pooled.mTexture);
+		gGLState.BindTexture(0, target, pooled.mTexture);
+		if (desc.mLayers > 0) {
+			glTexStorage3D(target, 1, desc.mInternalFormat, desc.mWidth, desc.mHeight, desc.mLayers);
+		}
+		else {
+			glTexStorage2D(target, 1, desc.mInternalFormat, desc.mWidth, desc.mHeight);
+		}
+		glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		gGLState.BindTexture(0, target, 0);
+
+		mPool.push_back(pooled);
+		texture.mPoolIndex = static_cast<uint32_t>(mPool.size() - 1);
+		spdlog::info("FRAMEGRAPH::POOL: Created {}x{} texture for {}, {} pooled", desc.mWidth, desc.mHeight, texture.mName, mPool.size());
+	}
+
+	PooledTexture& pooled = mPool[texture.mPoolIndex];
+	pooled.mInUse = true;
+	pooled.mLastFrame = mFrame;
+	texture.mTexture = pooled.mTexture;
+}
+
+void FrameGraph::release(TextureNode& texture)
+{
+	mPool[texture.mPoolIndex].mInUse = false;
+}
+
+void FrameGraph::retirePool()
+{
+	for (size_t i = 0; i < mPool.size();) {
+		if (mFrame - mPool[i].mLastFrame <= POOL_RETIRE_FRAMES) {
+			i++;
+			continue;
+		}
+
+		const GLuint texture = mPool[i].mTexture;
+		mFramebuffers.erase(std::remove_if(mFramebuffers.begin(), mFramebuffers.end(), [texture](const CachedFramebuffer& framebuffer) {
+			if (framebuffer.mColor != texture && framebuffer.mDepth != texture) {
+				return false;
+			}
+			glDeleteFramebuffers(1, &framebuffer.mFramebuffer);
+			gGLState.ForgetFramebuffer(framebuffer.mFramebuffer);
+			return true;
+		}), mFramebuffers.end());
+		glDeleteTextures(1, &texture);
+		gGLState.ForgetTexture(texture);
+		mPool.erase(mPool.begin() + i);
+	}
+}
+
+GLuint FrameGraph::GetFramebuffer(FrameGraphTexture color, FrameGraphTexture depth) const
+{
+	const GLuint colorTexture = color != INVALID_FRAME_GRAPH_TEXTURE ? mTextures[color].mTexture : 0;
+	const GLuint depthTexture = depth != INVALID_FRAME_GRAPH_TEXTURE ? mTextures[depth].mTexture : 0;
+	for (const CachedFramebuffer& framebuffer : mFramebuffers) {
+		if (framebuffer.mColor == colorTexture && framebuffer.mDepth == depthTexture) {
+			return framebuffer.mFramebuffer;
+		}
+	}
+
+	CachedFramebuffer framebuffer = { colorTexture, depthTexture, 0 };
+	glGenFramebuffers(1, &framebuffer.mFramebuffer);
+	gGLState.BindFramebuffer(GL_FRAMEBUFFER, framebuffer.mFramebuffer);
+	if (colorTexture) {
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, colorTexture, 0);
+	}
+	else {
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+	}
+	if (depthTexture) {
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0);
+	}
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		spdlog::error("FRAMEGRAPH::FRAMEBUFFER: Framebuffer for {} / {} is not complete!",
+			color != INVALID_FRAME_GRAPH_TEXTURE ? mTextures[color].mName : "none", depth != INVALID_FRAME_GRAPH_TEXTURE ? mTextures[depth].mName : "none");
+	}
+	mFramebuffers.push_back(framebuffer);
+	return framebuffer.mFramebuffer;
+}
+
+void FrameGraph::bindTargets(const PassNode& pass) const
+{
+	const FrameGraphTexture target = pass.mColor != INVALID_FRAME_GRAPH_TEXTURE ? pass.mColor : pass.mDepth;
+	gGLState.BindFramebuffer(GL_FRAMEBUFFER, GetFramebuffer(pass.mColor, pass.mDepth));
+	gGLState.Viewport(0, 0, mTextures[target].mDesc.mWidth, mTextures[target].mDesc.mHeight);
+
+	// With the clear color and depth the game set
+	GLbitfield clear = 0;
+	if (pass.mClearColor && pass.mColor != INVALID_FRAME_GRAPH_TEXTURE) {
+		clear |= GL_COLOR_BUFFER_BIT;
+	}
+	if (pass.mClearDepth && pass.mDepth != INVALID_FRAME_GRAPH_TEXTURE) {
+		clear |= GL_DEPTH_BUFFER_BIT;
+	}
+	if (clear != 0) {
+		glClear(clear);
+	}
+}
+
+void FrameGraph::Run()
+{
+	cull();
+	computeLifetimes();
+
+	for (uint32_t index = 0; index < mPasses.size(); index++) {
+		const PassNode& pass = mPasses[index];
+		if (pass.mCulled) {
+			continue;
+		}
+
+		GLbitfield barriers = 0;
+		for (FrameGraphTexture texture : pass.mReads) {
+			if (mTextures[texture].mImageWritten) {
+				barriers |= GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT;
+				mTextures[texture].mImageWritten = false;
+			}
+		}
+		if (barriers != 0) {
+			glMemoryBarrier(barriers);
+		}
+
+		for (FrameGraphTexture texture : pass.mWrites) {
+			TextureNode& node = mTextures[texture];
+			if (!node.mImported && node.mFirstPass == index) {
+				acquire(node);
+			}
+		}
+		if (pass.mColor != INVALID_FRAME_GRAPH_TEXTURE || pass.mDepth != INVALID_FRAME_GRAPH_TEXTURE) {
+			bindTargets(pass);
+		}
+
+		pass.mExecute(*this);
+
+		for (FrameGraphTexture texture : pass.mImageWrites) {
+			mTextures[texture].mImageWritten = true;
+		}
+		// Freed textures can back a later texture of this frame
+		auto releaseIfDone = [this, index](FrameGraphTexture texture) {
+			TextureNode& node = mTextures[texture];
+			if (!node.mImported && node.mLastPass == index && node.mPoolIndex != UINT32_MAX) {
+				release(node);
+			}
+		};
+		for (FrameGraphTexture texture : pass.mReads) {
+			releaseIfDone(texture);
+		}
+		for (FrameGraphTexture texture : pass.mWrites) {
+			releaseIfDone(texture);
+		}
+	}
+	gGLState.BindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	mFrame++;
+	retirePool();
+	mStats.mPooledTextures = static_cast<unsigned int>(mPool.size());
+	for (const PooledTexture& pooled : mPool) {
+		mStats.mPooledBytes += uint64_t(pooled.mDesc.mWidth) * pooled.mDesc.mHeight * std::max(1u, pooled.mDesc.mLayers) * texelBytes(pooled.mDesc.mInternalFormat);
+	}
+}
\ No newline at end of file
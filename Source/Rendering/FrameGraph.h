@@ -0,0 +1,150 @@
+#ifndef FRAME_GRAPH_H
+#define FRAME_GRAPH_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <glad/glad.h>
+
+using FrameGraphTexture = uint32_t;
+constexpr FrameGraphTexture INVALID_FRAME_GRAPH_TEXTURE = UINT32_MAX;
+
+struct FrameGraphTextureDesc {
+	unsigned int mWidth = 0;
+	unsigned int mHeight = 0;
+	unsigned int mLayers = 0;	// 0 for a GL_TEXTURE_2D, otherwise a GL_TEXTURE_2D_ARRAY
+	GLenum mInternalFormat = GL_RGBA8;
+
+	bool operator==(const FrameGraphTextureDesc& other) const {
+		return mWidth == other.mWidth && mHeight == other.mHeight && mLayers == other.mLayers && mInternalFormat == other.mInternalFormat;
+	}
+};
+
+struct FrameGraphStats {
+	unsigned int mPasses = 0;	// Declared this frame
+	unsigned int mCulledPasses = 0;	// Skipped because nothing used what they wrote
+	unsigned int mTransientTextures = 0;	// Created by passes this frame
+	unsigned int mPooledTextures = 0;	// GL textures behind them after aliasing
+	uint64_t mPooledBytes = 0;
+};
+
+class FrameGraph;
+
+// Declares what one pass touches, returned by FrameGraph::AddPass
+class FrameGraphBuilder {
+public:
+	FrameGraphBuilder(FrameGraph& graph, uint32_t pass) : mGraph(graph), mPass(pass) {}
+
+	// A texture that lives from this pass to its last reader, backed by the graph's pool
+	FrameGraphTexture Create(const char* name, const FrameGraphTextureDesc& desc);
+	// Sampled or copied from
+	void Read(FrameGraphTexture texture);
+	// Written by the pass itself, through its own framebuffers, copies or clears
+	void Write(FrameGraphTexture texture);
+	// Written with image stores, readers get a memory barrier first
+	void WriteImage(FrameGraphTexture texture);
+	// Render targets, the graph binds a framebuffer with them and sets the viewport before the pass runs
+	void WriteColor(FrameGraphTexture texture, bool clear = true);
+	void WriteDepth(FrameGraphTexture texture, bool clear = true);
+	// Never culled, for passes whose results leave the graph (the screen, readbacks, next frame)
+	void SideEffect();
+private:
+	FrameGraph& mGraph;
+	uint32_t mPass;
+};
+
+//---------------------------------------------------------------------------------
+// Rebuilt every frame: passes are declared in execution order along with the
+// textures they read and write, then Run() culls the passes nothing depends
+// on and runs the rest. Textures a pass creates are transient. They are backed
+// by a pool of GL textures, and any two with the same description whose
+// lifetimes (first to last pass using them) don't overlap share one. Today's
+// transients (RGBA8 scene color, D32F scene depth, the EVSM blur scratch) never
+// match, so within a frame the pool only saves the per-frame allocation.
+// Textures that have to outlive the frame, like the shadow maps, are imported.
+//---------------------------------------------------------------------------------
+class FrameGraph {
+public:
+	using Execute = std::function<void(const FrameGraph& graph)>;
+
+	// Drops last frame's passes, pooled textures and framebuffers stay
+	void Reset();
+
+	FrameGraphTexture Import(const char* name, GLuint texture, const FrameGraphTextureDesc& desc);
+	FrameGraphBuilder AddPass(const char* name, Execute execute);
+
+	// Culls, allocates, binds and runs the passes in the order they were added
+	void Run();
+
+	// Only valid while the passes using the texture run
+	GLuint GetTexture(FrameGraphTexture texture) const { return mTextures[texture].mTexture; }
+	const FrameGraphTextureDesc& GetDesc(FrameGraphTexture texture) const { return mTextures[texture].mDesc; }
+	// Cached framebuffer with these attachments, either can be INVALID_FRAME_GRAPH_TEXTURE
+	GLuint GetFramebuffer(FrameGraphTexture color, FrameGraphTexture depth) const;
+
+	const FrameGraphStats& GetStats() const { return mStats; }
+private:
+	friend class FrameGraphBuilder;
+
+	static constexpr uint32_t NO_PASS = UINT32_MAX;
+	// Pooled textures nothing asked for in this many frames are deleted
+	static constexpr unsigned int POOL_RETIRE_FRAMES = 60;
+
+	struct TextureNode {
+		const char* mName;
+		FrameGraphTextureDesc mDesc;
+		GLuint mTexture = 0;
+		bool mImported = false;
+		uint32_t mReaders = 0;	// Passes reading it that were not culled
+		uint32_t mFirstPass = NO_PASS;	// Lifetime over the executed passes
+		uint32_t mLastPass = NO_PASS;
+		uint32_t mPoolIndex = UINT32_MAX;
+		bool mImageWritten = false;	// Pending image stores the next reader has to wait for
+	};
+
+	struct PassNode {
+		const char* mName;
+		Execute mExecute;
+		std::vector<FrameGraphTexture> mReads;
+		std::vector<FrameGraphTexture> mWrites;
+		std::vector<FrameGraphTexture> mImageWrites;	// Also in mWrites
+		FrameGraphTexture mColor = INVALID_FRAME_GRAPH_TEXTURE;
+		FrameGraphTexture mDepth = INVALID_FRAME_GRAPH_TEXTURE;
+		bool mClearColor = false;
+		bool mClearDepth = false;
+		bool mSideEffect = false;
+		uint32_t mRefCount = 0;	// Written textures somebody still reads
+		bool mCulled = false;
+	};
+
+	struct PooledTexture {
+		FrameGraphTextureDesc mDesc;
+		GLuint mTexture = 0;
+		bool mInUse = false;
+		unsigned int mLastFrame = 0;
+	};
+
+	struct CachedFramebuffer {
+		GLuint mColor;
+		GLuint mDepth;
+		GLuint mFramebuffer;
+	};
+
+	void cull();
+	void computeLifetimes();
+	void acquire(TextureNode& texture);
+	void release(TextureNode& texture);
+	void retirePool();
+	void bindTargets(const PassNode& pass) const;
+
+	std::vector<TextureNode> mTextures;
+	std::vector<PassNode> mPasses;
+
+	std::vector<PooledTexture> mPool;
+	mutable std::vector<CachedFramebuffer> mFramebuffers;
+	unsigned int mFrame = 0;
+	FrameGraphStats mStats;
+};
+
+#endif
\ No newline at end of file
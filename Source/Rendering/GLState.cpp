@@ -0,0 +1,268 @@
+#include "GLState.h"
+
+GLState gGLState;
+
+static int textureTargetIndex(GLenum target)
+{
+	switch (target) {
+	case GL_TEXTURE_2D: return 0;
+	case GL_TEXTURE_2D_ARRAY: return 1;
+	default: return -1;
+	}
+}
+
+static int capabilityIndex(GLenum capability)
+{
+	switch (capability) {
+	case GL_CULL_FACE: return 0;
+	case GL_DEPTH_TEST: return 1;
+	case GL_DEPTH_CLAMP: return 2;
+	case GL_BLEND: return 3;
+	default: return -1;
+	}
+}
+
+void GLState::Invalidate()
+{
+	mProgram = UNKNOWN;
+	mVertexArray = UNKNOWN;
+	mActiveUnit = UNKNOWN;
+	for (uint32_t unit = 0; unit < TEXTURE_UNITS; unit++) {
+		for (uint32_t target = 0; target < TEXTURE_TARGETS; target++) {
+			mTextures[unit][target] = UNKNOWN;
+		}
+	}
+	for (uint32_t index = 0; index < BUFFER_BINDINGS; index++) {
+		mUniformBuffers[index] = BufferBinding();
+		mStorageBuffers[index] = BufferBinding();
+	}
+	mDrawFramebuffer = UNKNOWN;
+	mReadFramebuffer = UNKNOWN;
+	for (int i = 0; i < 4; i++) {
+		mViewport[i] = -1;
+		mCapabilities[i] = -1;
+	}
+	mCullFace = UNKNOWN;
+	mDepthFunc = UNKNOWN;
+	mDepthMask = -1;
+	mColorMask = -1;
+	mBlendSource = UNKNOWN;
+	mBlendDestination = UNKNOWN;
+}
+
+bool GLState::changed(bool differs)
+{
+	if (differs) {
+		mStats.mIssued++;
+	}
+	else {
+		mStats.mSuppressed++;
+	}
+	return differs;
+}
+
+void GLState::UseProgram(GLuint program)
+{
+	if (changed(mProgram != program)) {
+		mProgram = program;
+		glUseProgram(program);
+	}
+}
+
+void GLState::BindVertexArray(GLuint vao)
+{
+	if (changed(mVertexArray != vao)) {
+		mVertexArray = vao;
+		glBindVertexArray(vao);
+	}
+}
+
+void GLState::BindTexture(uint32_t unit, GLenum target, GLuint texture)
+{
+	const int targetIndex = textureTargetIndex(target);
+	if (unit < TEXTURE_UNITS && targetIndex >= 0 && !changed(mTextures[unit][targetIndex] != texture)) {
+		return;
+	}
+	if (mActiveUnit != unit) {
+		mActiveUnit = unit;
+		glActiveTexture(GL_TEXTURE0 + unit);
+	}
+	if (unit < TEXTURE_UNITS && targetIndex >= 0) {
+		mTextures[unit][targetIndex] = texture;
+	}
+	glBindTexture(target, texture);
+}
+
+void GLState::BindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	BufferBinding* bindings = target == GL_UNIFORM_BUFFER ? mUniformBuffers : target == GL_SHADER_STORAGE_BUFFER ? mStorageBuffers : nullptr;
+	if (bindings && index < BUFFER_BINDINGS) {
+		BufferBinding& binding = bindings[index];
+		if (!changed(binding.mBuffer != buffer || binding.mOffset != 0 || binding.mSize != 0)) {
+			return;
+		}
+		binding = { buffer, 0, 0 };
+	}
+	glBindBufferBase(target, index, buffer);
+}
+
+void GLState::BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	BufferBinding* bindings = target == GL_UNIFORM_BUFFER ? mUniformBuffers : target == GL_SHADER_STORAGE_BUFFER ? mStorageBuffers : nullptr;
+	if (bindings && index < BUFFER_BINDINGS) {
+		BufferBinding& binding = bindings[index];
+		if (!changed(binding.mBuffer != buffer || binding.mOffset != offset || binding.mSize != size)) {
+			return;
+		}
+		binding = { buffer, offset, size };
+	}
+	glBindBufferRange(target, index, buffer, offset, size);
+}
+
+void GLState::BindFramebuffer(GLenum target, GLuint framebuffer)
+{
+	const bool draw = target != GL_READ_FRAMEBUFFER;
+	const bool read = target != GL_DRAW_FRAMEBUFFER;
+	if (!changed((draw && mDrawFramebuffer != framebuffer) || (read && mReadFramebuffer != framebuffer))) {
+		return;
+	}
+	if (draw) {
+		mDrawFramebuffer = framebuffer;
+	}
+	if (read) {
+		mReadFramebuffer = framebuffer;
+	}
+	glBindFramebuffer(target, framebuffer);
+}
+
+void GLState::Viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	if (changed(mViewport[0] != x || mViewport[1] != y || mViewport[2] != width || mViewport[3] != height)) {
+		mViewport[0] = x;
+		mViewport[1] = y;
+		mViewport[2] = width;
+		mViewport[3] = height;
+		glViewport(x, y, width, height);
+	}
+}
+
+bool GLState::setCapability(GLenum capability, bool enabled)
+{
+	const int index = capabilityIndex(capability);
+	if (index < 0) {
+		return true;
+	}
+	if (!changed(mCapabilities[index] != int(enabled))) {
+		return false;
+	}
+	mCapabilities[index] = int(enabled);
+	return true;
+}
+
+void GLState::Enable(GLenum capability)
+{
+	if (setCapability(capability, true)) {
+		glEnable(capability);
+	}
+}
+
+void GLState::Disable(GLenum capability)
+{
+	if (setCapability(capability, false)) {
+		glDisable(capability);
+	}
+}
+
+void GLState::CullFace(GLenum face)
+{
+	if (changed(mCullFace != face)) {
+		mCullFace = face;
+		glCullFace(face);
+	}
+}
+
+void GLState::DepthFunc(GLenum func)
+{
+	if (changed(mDepthFunc != func)) {
+		mDepthFunc = func;
+		glDepthFunc(func);
+	}
+}
+
+void GLState::DepthMask(GLboolean mask)
+{
+	if (changed(mDepthMask != int(mask != GL_FALSE))) {
+		mDepthMask = int(mask != GL_FALSE);
+		glDepthMask(mask);
+	}
+}
+
+void GLState::ColorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha)
+{
+	const int mask = int(red != GL_FALSE) | int(green != GL_FALSE) << 1 | int(blue != GL_FALSE) << 2 | int(alpha != GL_FALSE) << 3;
+	if (changed(mColorMask != mask)) {
+		mColorMask = mask;
+		glColorMask(red, green, blue, alpha);
+	}
+}
+
+void GLState::BlendFunc(GLenum source, GLenum destination)
+{
+	if (changed(mBlendSource != source || mBlendDestination != destination)) {
+		mBlendSource = source;
+		mBlendDestination = destination;
+		glBlendFunc(source, destination);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// A deleted object's name can come back from the next glGen*. Without these the
+// cache would think the recycled name is still bound and drop a bind that is
+// needed, so the slots it was in go back to unknown instead.
+//-----------------------------------------------------------------------------
+void GLState::ForgetProgram(GLuint program)
+{
+	if (mProgram == program) {
+		mProgram = UNKNOWN;
+	}
+}
+
+void GLState::ForgetTexture(GLuint texture)
+{
+	for (uint32_t unit = 0; unit < TEXTURE_UNITS; unit++) {
+		for (uint32_t target = 0; target < TEXTURE_TARGETS; target++) {
+			if (mTextures[unit][target] == texture) {
+				mTextures[unit][target] = UNKNOWN;
+			}
+		}
+	}
+}
+
+void GLState::ForgetBuffer(GLuint buffer)
+{
+	for (uint32_t index = 0; index < BUFFER_BINDINGS; index++) {
+		if (mUniformBuffers[index].mBuffer == buffer) {
+			mUniformBuffers[index] = BufferBinding();
+		}
+		if (mStorageBuffers[index].mBuffer == buffer) {
+			mStorageBuffers[index] = BufferBinding();
+		}
+	}
+}
+
+void GLState::ForgetFramebuffer(GLuint framebuffer)
+{
+	if (mDrawFramebuffer == framebuffer) {
+		mDrawFramebuffer = UNKNOWN;
+	}
+	if (mReadFramebuffer == framebuffer) {
+		mReadFramebuffer = UNKNOWN;
+	}
+}
+
+GLStateStats GLState::TakeStats()
+{
+	const GLStateStats stats = mStats;
+	mStats = GLStateStats();
+	return stats;
+}
\ No newline at end of file
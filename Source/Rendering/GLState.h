@@ -0,0 +1,92 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <cstdint>
+
+#include <glad/glad.h>
+
+struct GLStateStats {
+	unsigned int mIssued = 0;	// State calls that reached GL
+	unsigned int mSuppressed = 0;	// Calls dropped because GL already had that state
+};
+
+//---------------------------------------------------------------------------------
+// Shadow copy of the GL state the passes keep changing: program, VAO, texture
+// units, UBO/SSBO bindings, framebuffers, viewport, culling, depth and blending.
+// A call that would set what is already set never reaches GL. Everything has to
+// go through here for the copy to stay right, so it is only used from the thread
+// that owns the context, and Invalidate() runs whenever that thread takes it.
+// Deleting an object has to be followed by the matching Forget* call.
+//---------------------------------------------------------------------------------
+class GLState {
+public:
+	GLState() { Invalidate(); }
+
+	// Forgets everything, the next call of each kind always reaches GL
+	void Invalidate();
+
+	void UseProgram(GLuint program);
+	void BindVertexArray(GLuint vao);
+	// Makes unit active when it is not, then binds. Targets other than 2D and 2D array go straight through
+	void BindTexture(uint32_t unit, GLenum target, GLuint texture);
+	// GL_UNIFORM_BUFFER and GL_SHADER_STORAGE_BUFFER are tracked, a base binding counts as offset 0 size 0
+	void BindBufferBase(GLenum target, GLuint index, GLuint buffer);
+	void BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+	// GL_FRAMEBUFFER sets both the draw and the read binding
+	void BindFramebuffer(GLenum target, GLuint framebuffer);
+	void Viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+	// GL_CULL_FACE, GL_DEPTH_TEST, GL_DEPTH_CLAMP and GL_BLEND are tracked
+	void Enable(GLenum capability);
+	void Disable(GLenum capability);
+	void CullFace(GLenum face);
+	void DepthFunc(GLenum func);
+	void DepthMask(GLboolean mask);
+	void ColorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha);
+	void BlendFunc(GLenum source, GLenum destination);
+
+	void ForgetProgram(GLuint program);
+	void ForgetTexture(GLuint texture);
+	void ForgetBuffer(GLuint buffer);
+	void ForgetFramebuffer(GLuint framebuffer);
+
+	// Counters since the last call
+	GLStateStats TakeStats();
+private:
+	static constexpr uint32_t TEXTURE_UNITS = 16;
+	static constexpr uint32_t TEXTURE_TARGETS = 2;	// GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY
+	static constexpr uint32_t BUFFER_BINDINGS = 32;
+	static constexpr uint32_t CAPABILITIES = 4;
+	static constexpr GLuint UNKNOWN = UINT32_MAX;
+
+	struct BufferBinding {
+		GLuint mBuffer = UNKNOWN;
+		GLintptr mOffset = 0;
+		GLsizeiptr mSize = 0;
+	};
+
+	bool setCapability(GLenum capability, bool enabled);
+	bool changed(bool differs);
+
+	GLuint mProgram = UNKNOWN;
+	GLuint mVertexArray = UNKNOWN;
+	GLuint mActiveUnit = UNKNOWN;
+	GLuint mTextures[TEXTURE_UNITS][TEXTURE_TARGETS];
+	BufferBinding mUniformBuffers[BUFFER_BINDINGS];
+	BufferBinding mStorageBuffers[BUFFER_BINDINGS];
+	GLuint mDrawFramebuffer = UNKNOWN;
+	GLuint mReadFramebuffer = UNKNOWN;
+	GLint mViewport[4] = { -1, -1, -1, -1 };
+	int mCapabilities[CAPABILITIES] = { -1, -1, -1, -1 };	// -1 unknown, else 0 or 1
+	GLenum mCullFace = UNKNOWN;
+	GLenum mDepthFunc = UNKNOWN;
+	int mDepthMask = -1;
+	int mColorMask = -1;	// Four bits, red lowest
+	GLenum mBlendSource = UNKNOWN;
+	GLenum mBlendDestination = UNKNOWN;
+	GLStateStats mStats;
+};
+
+extern GLState gGLState;
+
+#endif
\ No newline at end of file
@@ -0,0 +1,131 @@
+#include "GeometryBuffer.h"
+
+#include "Log/Logger.h"
+#include "Rendering/GLState.h"
+
+static constexpr size_t INITIAL_VERTEX_CAPACITY = 1 << 16;
+static constexpr size_t INITIAL_INDEX_CAPACITY = 1 << 18;
+
+GeometryRange GeometryBuffer::Allocate(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices)
+{
+	if (mVao == 0) {
+		init();
+	}
+
+	const size_t vertexCapacity = mVertexCapacity;
+	const size_t indexCapacity = mIndexCapacity;
+	grow(GL_ARRAY_BUFFER, mVertexBuffer, sizeof(Vertex), mVertexCount, mVertexCapacity, mVertexCount + vertices.size());
+	grow(GL_ARRAY_BUFFER, mPositionBuffer, sizeof(glm::vec3), mVertexCount, mPositionCapacity, mVertexCount + vertices.size());
+	grow(GL_ELEMENT_ARRAY_BUFFER, mIndexBuffer, sizeof(unsigned int), mIndexCount, mIndexCapacity, mIndexCount + indices.size());
+
+	// A VAO keeps the buffer names it was set up with, so point it at the new ones
+	if (vertexCapacity != mVertexCapacity || indexCapacity != mIndexCapacity) {
+		setupVertexArray();
+	}
+
+	GeometryRange range;
+	range.firstIndex = static_cast<unsigned int>(mIndexCount);
+	range.indexCount = static_cast<unsigned int>(indices.size());
+	range.baseVertex = static_cast<int>(mVertexCount);
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, mVertexBuffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, mVertexCount * sizeof(Vertex), vertices.size() * sizeof(Vertex), vertices.data());
+	glBindBuffer(GL_COPY_WRITE_BUFFER, mIndexBuffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, mIndexCount * sizeof(unsigned int), indices.size() * sizeof(unsigned int), indices.data());
+
+	std::vector<glm::vec3> positions(vertices.size());
+	for (size_t i = 0; i < vertices.size(); ++i) {
+		positions[i] = vertices[i].position;
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, mPositionBuffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, mVertexCount * sizeof(glm::vec3), positions.size() * sizeof(glm::vec3), positions.data());
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	mVertexCount += vertices.size();
+	mIndexCount += indices.size();
+
+	return range;
+}
+
+void GeometryBuffer::init()
+{
+	glGenVertexArrays(1, &mVao);
+	glGenVertexArrays(1, &mPositionVao);
+	grow(GL_ARRAY_BUFFER, mVertexBuffer, sizeof(Vertex), 0, mVertexCapacity, INITIAL_VERTEX_CAPACITY);
+	grow(GL_ARRAY_BUFFER, mPositionBuffer, sizeof(glm::vec3), 0, mPositionCapacity, INITIAL_VERTEX_CAPACITY);
+	grow(GL_ELEMENT_ARRAY_BUFFER, mIndexBuffer, sizeof(unsigned int), 0, mIndexCapacity, INITIAL_INDEX_CAPACITY);
+	setupVertexArray();
+}
+
+//-----------------------------------------------------------------------------
+// Reallocates a buffer to at least the required element count (doubling) and
+// copies the used part across on the GPU.
+//-----------------------------------------------------------------------------
+void GeometryBuffer::grow(GLenum target, GLuint& buffer, size_t elementSize, size_t used, size_t& capacity, size_t required)
+{
+	if (required <= capacity) {
+		return;
+	}
+
+	size_t newCapacity = capacity > 0 ? capacity : required;
+	while (newCapacity < required) {
+		newCapacity *= 2;
+	}
+
+	GLuint newBuffer;
+	glGenBuffers(1, &newBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, newCapacity * elementSize, nullptr, GL_STATIC_DRAW);
+
+	if (buffer != 0) {
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used * elementSize);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glDeleteBuffers(1, &buffer);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	spdlog::debug("GEOMETRYBUFFER::GROW: {} buffer now holds {} elements", target == GL_ARRAY_BUFFER ? "Vertex" : "Index", newCapacity);
+
+	buffer = newBuffer;
+	capacity = newCapacity;
+}
+
+void GeometryBuffer::setupVertexArray()
+{
+	gGLState.BindVertexArray(mVao);
+	glBindBuffer(GL_ARRAY_BUFFER, mVertexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndexBuffer);
+
+	//-----------------------------------------------------------------------------
+	// Set vertex attributes pointers 
+	//-----------------------------------------------------------------------------
+	// Position 
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+	glEnableVertexAttribArray(0);
+	// Normal
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+	glEnableVertexAttribArray(1);
+	// Texture Coord
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
+	glEnableVertexAttribArray(2);
+	// Color
+	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, color));
+	glEnableVertexAttribArray(3);
+	// Tangent
+	glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tangent));
+	glEnableVertexAttribArray(4);
+	// Bitangent
+	glVertexAttribPointer(5, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, bitangent));
+	glEnableVertexAttribArray(5);
+
+	// Position only, shares the index buffer
+	gGLState.BindVertexArray(mPositionVao);
+	glBindBuffer(GL_ARRAY_BUFFER, mPositionBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndexBuffer);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+	glEnableVertexAttribArray(0);
+
+	gGLState.BindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
@@ -0,0 +1,51 @@
+#ifndef GEOMETRY_BUFFER_H
+#define GEOMETRY_BUFFER_H
+
+#include <cstddef>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "Rendering/Mesh.h"
+
+// Where a mesh ended up inside the shared buffers
+struct GeometryRange {
+	unsigned int firstIndex = 0;
+	unsigned int indexCount = 0;
+	int baseVertex = 0;
+};
+
+//---------------------------------------------------------------------------------
+// Shared vertex and index buffers for every mesh with the same vertex format, so
+// the whole scene draws from one VAO. Meshes are appended, indices stay relative
+// to the mesh and are offset with the base vertex when drawing. There is one of
+// these per vertex format, which for now means one for Vertex.
+// Positions are also kept in a tightly packed stream of their own, indexed the
+// same way, for depth only passes that would otherwise fetch whole vertices.
+//---------------------------------------------------------------------------------
+class GeometryBuffer {
+public:
+	GeometryRange Allocate(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
+
+	GLuint GetVertexArray() const { return mVao; }
+	GLuint GetPositionVertexArray() const { return mPositionVao; }	// Attribute 0 only
+	size_t GetVertexCount() const { return mVertexCount; }
+	size_t GetIndexCount() const { return mIndexCount; }
+private:
+	void init();
+	void setupVertexArray();
+	static void grow(GLenum target, GLuint& buffer, size_t elementSize, size_t used, size_t& capacity, size_t required);
+
+	GLuint mVao = 0;
+	GLuint mPositionVao = 0;
+	GLuint mVertexBuffer = 0;
+	GLuint mPositionBuffer = 0;
+	GLuint mIndexBuffer = 0;
+	size_t mVertexCount = 0;
+	size_t mVertexCapacity = 0;
+	size_t mPositionCapacity = 0;
+	size_t mIndexCount = 0;
+	size_t mIndexCapacity = 0;
+};
+
+#endif
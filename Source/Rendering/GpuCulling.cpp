@@ -0,0 +1,216 @@
+#include "GpuCulling.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Log/Logger.h"
+#include "Core/Resources.h"
+#include "Rendering/Bindings.h"
+#include "Rendering/GLState.h"
+#include "Rendering/Mesh.h"
+#include "Rendering/Renderer.h"
+
+static constexpr uint32_t CULL_GROUP_SIZE = 64;
+static constexpr uint32_t HIZ_GROUP_SIZE = 8;
+
+// Matches Bounds in cull.comp
+struct RecordBounds {
+	glm::vec4 mMin;
+	glm::vec4 mMax;
+};
+
+void GpuCulling::Init(unsigned int width, unsigned int height)
+{
+	mCullProgram = &gResources.mShaderPrograms.at("cull");
+	mStageUniform = mCullProgram->GetUniform<int>("stage");
+	mFirstUniform = mCullProgram->GetUniform<int>("first");
+	mCountUniform = mCullProgram->GetUniform<int>("count");
+	mCascadeCountUniform = mCullProgram->GetUniform<int>("cascadeCount");
+	mLayeredUniform = mCullProgram->GetUniform<int>("layered");
+	mOcclusionUniform = mCullProgram->GetUniform<int>("occlusion");
+	mViewProjectionUniform = mCullProgram->GetUniform<glm::mat4>("viewProjection");
+	mHiZViewProjectionUniform = mCullProgram->GetUniform<glm::mat4>("hiZViewProjection");
+	mCullProgram->BindUniformBlock("LightSpaceMatrices", BINDING_LIGHT_SPACE_MATRICES);
+
+	mHiZProgram = &gResources.mShaderPrograms.at("hiZ");
+	mDownsampleUniform = mHiZProgram->GetUniform<int>("downsample");
+	mSourceLevelUniform = mHiZProgram->GetUniform<int>("sourceLevel");
+
+	//-----------------------------------------------------------------------------
+	// Hi-Z pyramid, full mip chain of the screen
+	//-----------------------------------------------------------------------------
+	mWidth = width;
+	mHeight = height;
+	mHiZLevels = 1 + static_cast<int>(std::floor(std::log2(float(std::max(width, height)))));
+
+	glGenTextures(1, &mHiZTexture);
+	gGLState.BindTexture(0, GL_TEXTURE_2D, mHiZTexture);
+	glTexStorage2D(GL_TEXTURE_2D, mHiZLevels, GL_R32F, width, height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	gGLState.BindTexture(0, GL_TEXTURE_2D, 0);
+
+	glGenBuffers(1, &mCulledCommandBuffer);
+	glGenBuffers(1, &mCulledInstanceBuffer);
+	glGenBuffers(1, &mInstanceInfoBuffer);
+	glGenBuffers(1, &mCountBuffer);
+	glGenBuffers(1, &mBoundsBuffer);
+
+	uploadRecordBounds();
+}
+
+void GpuCulling::Upload(GLuint commandBuffer, GLuint instanceBuffer, const std::vector<InstanceInfo>& infos, size_t commandCount)
+{
+	// Meshes loaded after Init need their bounds on the GPU too
+	if (gResources.mDrawRecords.size() != mRecordCount) {
+		uploadRecordBounds();
+	}
+
+	ensureCapacity(commandCount, infos.size());
+	mCommandBuffer = commandBuffer;
+	mInstanceBuffer = instanceBuffer;
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mInstanceInfoBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, infos.size() * sizeof(InstanceInfo), infos.data());
+
+	const uint32_t zero = 0;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mCountBuffer);
+	glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, 0, commandCount * sizeof(uint32_t), GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void GpuCulling::CullCamera(const CullRange& range, const glm::mat4& viewProjection)
+{
+	gGLState.UseProgram(mCullProgram->mId);
+	mCullProgram->Set(mCascadeCountUniform, 0);
+	mCullProgram->Set(mViewProjectionUniform, viewProjection);
+	mCullProgram->Set(mOcclusionUniform, mHiZValid ? 1 : 0);
+	mCullProgram->Set(mHiZViewProjectionUniform, mHiZViewProjection);
+
+	gGLState.BindTexture(0, GL_TEXTURE_2D, mHiZTexture);
+	dispatch(range);
+	gGLState.BindTexture(0, GL_TEXTURE_2D, 0);
+}
+
+void GpuCulling::CullCascades(const CullRange& range, int cascadeCount, bool layered)
+{
+	gGLState.UseProgram(mCullProgram->mId);
+	mCullProgram->Set(mCascadeCountUniform, std::min(cascadeCount, int(MAX_CASCADES)));
+	mCullProgram->Set(mLayeredUniform, layered ? 1 : 0);
+	mCullProgram->Set(mOcclusionUniform, 0);
+	dispatch(range);
+}
+
+void GpuCulling::dispatch(const CullRange& range)
+{
+	if (range.mCommandCount == 0) {
+		return;
+	}
+
+	gGLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_DRAW_COMMANDS, mCommandBuffer);
+	gGLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_CULLED_COMMANDS, mCulledCommandBuffer);
+	gGLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_INSTANCE_INFO, mInstanceInfoBuffer);
+	gGLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_INSTANCE_COUNTS, mCountBuffer);
+	gGLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_RECORD_BOUNDS, mBoundsBuffer);
+	gGLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_INSTANCES, mInstanceBuffer);
+	gGLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_CULLED_INSTANCES, mCulledInstanceBuffer);
+
+	// Stage 0 tests and compacts the instances, stage 1 writes the commands with the counts
+	mCullProgram->Set(mStageUniform, 0);
+	mCullProgram->Set(mFirstUniform, int(range.mFirstInstance));
+	mCullProgram->Set(mCountUniform, int(range.mInstanceCount));
+	glDispatchCompute((range.mInstanceCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	mCullProgram->Set(mStageUniform, 1);
+	mCullProgram->Set(mFirstUniform, int(range.mFirstCommand));
+	mCullProgram->Set(mCountUniform, int(range.mCommandCount));
+	glDispatchCompute((range.mCommandCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+	// The draws read the commands, the vertex shaders read the instances
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+//-----------------------------------------------------------------------------
+// Copies depth into level 0, then reduces each level into the next keeping the
+// farthest depth, so a box behind a level's texel is behind everything under it.
+//-----------------------------------------------------------------------------
+void GpuCulling::BuildHiZ(GLuint depthTexture, const glm::mat4& viewProjection)
+{
+	gGLState.UseProgram(mHiZProgram->mId);
+
+	for (int level = 0; level < mHiZLevels; ++level) {
+		const unsigned int width = std::max(mWidth >> level, 1u);
+		const unsigned int height = std::max(mHeight >> level, 1u);
+
+		gGLState.BindTexture(0, GL_TEXTURE_2D, level == 0 ? depthTexture : mHiZTexture);
+		mHiZProgram->Set(mDownsampleUniform, level == 0 ? 0 : 1);
+		mHiZProgram->Set(mSourceLevelUniform, level - 1);
+		glBindImageTexture(0, mHiZTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+		glDispatchCompute((width + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE, (height + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	}
+	gGLState.BindTexture(0, GL_TEXTURE_2D, 0);
+
+	mHiZViewProjection = viewProjection;
+	mHiZValid = true;
+}
+
+void GpuCulling::BindForDraw() const
+{
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mCulledCommandBuffer);
+	gGLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_INSTANCES, mCulledInstanceBuffer);
+}
+
+uint32_t GpuCulling::ReadVisibleCount(const CullRange& range) const
+{
+	std::vector<uint32_t> counts(range.mCommandCount);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mCountBuffer);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, range.mFirstCommand * sizeof(uint32_t), counts.size() * sizeof(uint32_t), counts.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	uint32_t visible = 0;
+	for (uint32_t count : counts) {
+		visible += count;
+	}
+	return visible;
+}
+
+void GpuCulling::uploadRecordBounds()
+{
+	std::vector<RecordBounds> bounds;
+	bounds.reserve(gResources.mDrawRecords.size());
+	for (const DrawRecord& record : gResources.mDrawRecords) {
+		bounds.push_back({ glm::vec4(record.boundsMin, 1.0f), glm::vec4(record.boundsMax, 1.0f) });
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mBoundsBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, bounds.size() * sizeof(RecordBounds), bounds.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	mRecordCount = bounds.size();
+}
+
+void GpuCulling::ensureCapacity(size_t commandCount, size_t instanceCount)
+{
+	if (commandCount > mCommandCapacity) {
+		mCommandCapacity = std::max(commandCount, mCommandCapacity * 2);
+		resizeBuffer(mCulledCommandBuffer, mCommandCapacity * sizeof(DrawElementsIndirectCommand));
+		resizeBuffer(mCountBuffer, mCommandCapacity * sizeof(uint32_t));
+	}
+	if (instanceCount > mInstanceCapacity) {
+		mInstanceCapacity = std::max(instanceCount, mInstanceCapacity * 2);
+		resizeBuffer(mCulledInstanceBuffer, mInstanceCapacity * sizeof(uint32_t));
+		resizeBuffer(mInstanceInfoBuffer, mInstanceCapacity * sizeof(InstanceInfo));
+	}
+}
+
+void GpuCulling::resizeBuffer(GLuint& buffer, size_t size)
+{
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
@@ -0,0 +1,99 @@
+#ifndef GPU_CULLING_H
+#define GPU_CULLING_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "Core/Math.h"
+#include "Rendering/Shader.h"
+
+// What the cull kernel needs to know about one instance besides its object index (std430)
+struct InstanceInfo {
+	uint32_t mCommand;	// Indirect command the instance belongs to
+	uint32_t mRecord;	// Index into gResources.mDrawRecords, for the bounds
+};
+
+// Layered shadow instances pack the cascade above the object index, shared with the shaders
+constexpr uint32_t INSTANCE_CASCADE_SHIFT = 28;
+constexpr uint32_t INSTANCE_OBJECT_MASK = (1u << INSTANCE_CASCADE_SHIFT) - 1;
+
+// The commands and instances of one pass
+struct CullRange {
+	uint32_t mFirstCommand = 0;
+	uint32_t mCommandCount = 0;
+	uint32_t mFirstInstance = 0;
+	uint32_t mInstanceCount = 0;
+};
+
+//---------------------------------------------------------------------------------
+// Culls the instances of the indirect commands built on the CPU with a compute
+// pass. Each instance is tested on its own; survivors are compacted into the
+// front of their command's range in a second instance buffer, and a second
+// dispatch writes the commands with the surviving instance counts, so the passes
+// draw exactly like the CPU path with the culled buffers bound.
+// The camera view is also tested against a Hi-Z pyramid built from the previous
+// frame's depth. The shadow view tests each submesh against the extruded volumes
+// of the cascades its object was already found in on the CPU.
+//---------------------------------------------------------------------------------
+class GpuCulling {
+public:
+	static constexpr uint32_t MAX_CASCADES = 16;
+
+	void Init(unsigned int width, unsigned int height);
+
+	// Takes the frame's candidate commands and instances, must be called before any Cull* call
+	void Upload(GLuint commandBuffer, GLuint instanceBuffer, const std::vector<InstanceInfo>& infos, size_t commandCount);
+	void CullCamera(const CullRange& range, const glm::mat4& viewProjection);
+	// Layered instances carry their cascade (see INSTANCE_CASCADE_SHIFT) and are only tested against it
+	void CullCascades(const CullRange& range, int cascadeCount, bool layered);
+
+	// Builds the pyramid from the depth texture the camera view was just rendered into
+	void BuildHiZ(GLuint depthTexture, const glm::mat4& viewProjection);
+
+	// Binds the culled commands as the indirect buffer and the culled instances for the vertex shaders
+	void BindForDraw() const;
+
+	// Reads the instance counts back, stalls, only meant for stats/verification
+	uint32_t ReadVisibleCount(const CullRange& range) const;
+private:
+	void uploadRecordBounds();
+	void ensureCapacity(size_t commandCount, size_t instanceCount);
+	void dispatch(const CullRange& range);
+	static void resizeBuffer(GLuint& buffer, size_t size);
+
+	ShaderProgram* mCullProgram = nullptr;
+	ShaderProgram* mHiZProgram = nullptr;
+
+	UniformHandle<int> mStageUniform;
+	UniformHandle<int> mFirstUniform;
+	UniformHandle<int> mCountUniform;
+	UniformHandle<int> mCascadeCountUniform;
+	UniformHandle<int> mLayeredUniform;
+	UniformHandle<int> mOcclusionUniform;
+	UniformHandle<glm::mat4> mViewProjectionUniform;
+	UniformHandle<glm::mat4> mHiZViewProjectionUniform;
+	UniformHandle<int> mDownsampleUniform;
+	UniformHandle<int> mSourceLevelUniform;
+
+	GLuint mCommandBuffer = 0;		// Owned by the renderer
+	GLuint mInstanceBuffer = 0;		// Owned by the renderer
+	GLuint mCulledCommandBuffer = 0;
+	GLuint mCulledInstanceBuffer = 0;
+	GLuint mInstanceInfoBuffer = 0;
+	GLuint mCountBuffer = 0;
+	GLuint mBoundsBuffer = 0;
+	size_t mCommandCapacity = 0;
+	size_t mInstanceCapacity = 0;
+	size_t mRecordCount = 0;
+
+	GLuint mHiZTexture = 0;
+	int mHiZLevels = 0;
+	unsigned int mWidth = 0;
+	unsigned int mHeight = 0;
+	bool mHiZValid = false;
+	glm::mat4 mHiZViewProjection = glm::mat4(1.0f);
+};
+
+#endif
@@ -0,0 +1,216 @@
+#include "LightClusters.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glad/glad.h>
+
+#include "Core/JobSystem.h"
+#include "Rendering/Bindings.h"
+#include "Rendering/GLState.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CLUSTERS_SSE
+#endif
+
+// Orphans the old storage so the driver never waits on last frame's draws
+static void uploadBuffer(unsigned int buffer, unsigned int binding, const void* data, size_t size)
+{
+	// Never empty, a zero sized store can't be bound
+	const GLsizeiptr storage = std::max<GLsizeiptr>(size, 16);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, storage, nullptr, GL_STREAM_DRAW);
+	if (size > 0) {
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size, data);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	gGLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer);
+}
+
+void LightClusters::Init()
+{
+	glGenBuffers(1, &mLightBuffer);
+	glGenBuffers(1, &mClusterBuffer);
+	glGenBuffers(1, &mIndexBuffer);
+
+	mCenterX.resize(CLUSTER_COUNT);
+	mCenterY.resize(CLUSTER_COUNT);
+	mCenterZ.resize(CLUSTER_COUNT);
+	mExtentX.resize(CLUSTER_COUNT);
+	mExtentY.resize(CLUSTER_COUNT);
+	mExtentZ.resize(CLUSTER_COUNT);
+	mSliceDepths.resize(CLUSTERS_Z + 1);
+	mClusterLights.resize(CLUSTER_COUNT);
+	mClusterRanges.resize(CLUSTER_COUNT);
+}
+
+//-----------------------------------------------------------------------------
+// Slice k spans near * (far / near)^(k / CLUSTERS_Z) to the next boundary, so
+// clusters stay roughly cube shaped with distance. A tile edge at NDC x sits
+// at x * depth * tan(fov / 2) * aspect in view space, the box around a cluster
+// takes the wider of its near and far faces.
+//-----------------------------------------------------------------------------
+void LightClusters::buildClusterBounds(const Camera& camera)
+{
+	const float nearPlane = camera.GetNearPlane();
+	const float farPlane = camera.GetFarPlane();
+	const float tanY = std::tan(glm::radians(camera.GetFOV()) * 0.5f);
+	const float tanX = tanY * camera.GetAspectRatio();
+	const float logRange = std::log(farPlane / nearPlane);
+
+	mSliceScale = CLUSTERS_Z / logRange;
+	mSliceBias = -static_cast<float>(CLUSTERS_Z) * std::log(nearPlane) / logRange;
+	for (uint32_t z = 0; z <= CLUSTERS_Z; z++) {
+		mSliceDepths[z] = nearPlane * std::pow(farPlane / nearPlane, static_cast<float>(z) / CLUSTERS_Z);
+	}
+
+	for (uint32_t z = 0; z < CLUSTERS_Z; z++) {
+		const float depthNear = mSliceDepths[z];
+		const float depthFar = mSliceDepths[z + 1];
+		for (uint32_t y = 0; y < CLUSTERS_Y; y++) {
+			const float ndcBottom = -1.0f + 2.0f * y / CLUSTERS_Y;
+			const float ndcTop = -1.0f + 2.0f * (y + 1) / CLUSTERS_Y;
+			for (uint32_t x = 0; x < CLUSTERS_X; x++) {
+				const float ndcLeft = -1.0f + 2.0f * x / CLUSTERS_X;
+				const float ndcRight = -1.0f + 2.0f * (x + 1) / CLUSTERS_X;
+
+				const glm::vec3 boxMin(
+					std::min(ndcLeft * depthNear, ndcLeft * depthFar) * tanX,
+					std::min(ndcBottom * depthNear, ndcBottom * depthFar) * tanY,
+					-depthFar);
+				const glm::vec3 boxMax(
+					std::max(ndcRight * depthNear, ndcRight * depthFar) * tanX,
+					std::max(ndcTop * depthNear, ndcTop * depthFar) * tanY,
+					-depthNear);
+
+				const uint32_t cluster = (z * CLUSTERS_Y + y) * CLUSTERS_X + x;
+				mCenterX[cluster] = (boxMin.x + boxMax.x) * 0.5f;
+				mCenterY[cluster] = (boxMin.y + boxMax.y) * 0.5f;
+				mCenterZ[cluster] = (boxMin.z + boxMax.z) * 0.5f;
+				mExtentX[cluster] = (boxMax.x - boxMin.x) * 0.5f;
+				mExtentY[cluster] = (boxMax.y - boxMin.y) * 0.5f;
+				mExtentZ[cluster] = (boxMax.z - boxMin.z) * 0.5f;
+			}
+		}
+	}
+}
+
+glm::vec3 LightClusters::GetScale(unsigned int screenWidth, unsigned int screenHeight) const
+{
+	return glm::vec3(static_cast<float>(CLUSTERS_X) / screenWidth, static_cast<float>(CLUSTERS_Y) / screenHeight, mSliceScale);
+}
+
+void LightClusters::Update(const Camera& camera, const std::vector<Light>& lights)
+{
+	const glm::vec4 boundsKey(camera.GetFOV(), camera.GetAspectRatio(), camera.GetNearPlane(), camera.GetFarPlane());
+	if (boundsKey != mBoundsKey) {
+		buildClusterBounds(camera);
+		mBoundsKey = boundsKey;
+	}
+
+	const glm::mat4 view = camera.GetView();
+	mSpheres.resize(lights.size());
+	mGpuLights.resize(lights.size());
+	for (size_t i = 0; i < lights.size(); i++) {
+		const Light& light = lights[i];
+		const glm::vec3 position = light.mPosition;
+		const glm::vec3 direction = glm::normalize(light.mDirection);
+
+		// Spot cones get the smallest sphere around the cone instead of the whole range
+		glm::vec3 center = position;
+		float radius = light.mRange;
+		if (light.mType == LightType::LIGHT_TYPE_SPOT) {
+			const float cosAngle = std::clamp(light.mOuterCos, 0.0f, 1.0f);
+			if (cosAngle >= 0.70710678f) {
+				radius = light.mRange / (2.0f * cosAngle);
+				center = position + direction * radius;
+			}
+			else {
+				center = position + direction * (light.mRange * cosAngle);
+				radius = light.mRange * std::sqrt(1.0f - cosAngle * cosAngle);
+			}
+		}
+		mSpheres[i] = glm::vec4(glm::vec3(view * glm::vec4(center, 1.0f)), radius);
+
+		GpuLight& gpuLight = mGpuLights[i];
+		gpuLight.mPositionRange = glm::vec4(position, light.mRange);
+		gpuLight.mColor = glm::vec4(light.mColor * light.mIntensity, 1.0f);
+		gpuLight.mDirectionType = glm::vec4(direction, static_cast<float>(light.mType));
+		gpuLight.mSpot = glm::vec4(light.mInnerCos, light.mOuterCos, 0.0f, 0.0f);
+	}
+
+	// A slice per job, slices never share clusters so the lists need no locking
+	gJobSystem.ParallelFor(CLUSTERS_Z, 1, [this](uint32_t begin, uint32_t end) {
+		for (uint32_t slice = begin; slice < end; slice++) {
+			binSlice(slice);
+		}
+	});
+
+	mIndices.clear();
+	for (uint32_t cluster = 0; cluster < CLUSTER_COUNT; cluster++) {
+		const std::vector<uint32_t>& clusterLights = mClusterLights[cluster];
+		mClusterRanges[cluster] = glm::uvec2(static_cast<uint32_t>(mIndices.size()), static_cast<uint32_t>(clusterLights.size()));
+		mIndices.insert(mIndices.end(), clusterLights.begin(), clusterLights.end());
+	}
+
+	uploadBuffer(mLightBuffer, BINDING_LIGHTS, mGpuLights.data(), mGpuLights.size() * sizeof(GpuLight));
+	uploadBuffer(mClusterBuffer, BINDING_LIGHT_CLUSTERS, mClusterRanges.data(), mClusterRanges.size() * sizeof(glm::uvec2));
+	uploadBuffer(mIndexBuffer, BINDING_LIGHT_INDICES, mIndices.data(), mIndices.size() * sizeof(uint32_t));
+}
+
+//-----------------------------------------------------------------------------
+// A sphere touches a box when the distance from its center to the box, per
+// axis max(|c - center| - extent, 0), is within the radius. Lights are
+// rejected against the slice's depth range first, the survivors are tested
+// against every tile of the slice.
+//-----------------------------------------------------------------------------
+void LightClusters::binSlice(uint32_t slice)
+{
+	const uint32_t first = slice * SLICE_CLUSTERS;
+	for (uint32_t cluster = first; cluster < first + SLICE_CLUSTERS; cluster++) {
+		mClusterLights[cluster].clear();
+	}
+
+	const float depthNear = mSliceDepths[slice];
+	const float depthFar = mSliceDepths[slice + 1];
+	for (uint32_t light = 0; light < mSpheres.size(); light++) {
+		const glm::vec4& sphere = mSpheres[light];
+		const float depth = -sphere.z;
+		if (depth + sphere.w < depthNear || depth - sphere.w > depthFar) {
+			continue;
+		}
+
+#if defined(CLUSTERS_SSE)
+		const __m128 sphereX = _mm_set1_ps(sphere.x);
+		const __m128 sphereY = _mm_set1_ps(sphere.y);
+		const __m128 sphereZ = _mm_set1_ps(sphere.z);
+		const __m128 radiusSq = _mm_set1_ps(sphere.w * sphere.w);
+		const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+		const __m128 zero = _mm_setzero_ps();
+
+		for (uint32_t i = first; i < first + SLICE_CLUSTERS; i += 4) {
+			const __m128 dx = _mm_max_ps(_mm_sub_ps(_mm_and_ps(_mm_sub_ps(sphereX, _mm_loadu_ps(&mCenterX[i])), absMask), _mm_loadu_ps(&mExtentX[i])), zero);
+			const __m128 dy = _mm_max_ps(_mm_sub_ps(_mm_and_ps(_mm_sub_ps(sphereY, _mm_loadu_ps(&mCenterY[i])), absMask), _mm_loadu_ps(&mExtentY[i])), zero);
+			const __m128 dz = _mm_max_ps(_mm_sub_ps(_mm_and_ps(_mm_sub_ps(sphereZ, _mm_loadu_ps(&mCenterZ[i])), absMask), _mm_loadu_ps(&mExtentZ[i])), zero);
+			const __m128 distanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+			const int mask = _mm_movemask_ps(_mm_cmple_ps(distanceSq, radiusSq));
+			for (int lane = 0; lane < 4; lane++) {
+				if (mask & (1 << lane)) {
+					mClusterLights[i + lane].push_back(light);
+				}
+			}
+		}
+#else
+		for (uint32_t i = first; i < first + SLICE_CLUSTERS; i++) {
+			const float dx = std::max(std::abs(sphere.x - mCenterX[i]) - mExtentX[i], 0.0f);
+			const float dy = std::max(std::abs(sphere.y - mCenterY[i]) - mExtentY[i], 0.0f);
+			const float dz = std::max(std::abs(sphere.z - mCenterZ[i]) - mExtentZ[i], 0.0f);
+			if (dx * dx + dy * dy + dz * dz <= sphere.w * sphere.w) {
+				mClusterLights[i].push_back(light);
+			}
+		}
+#endif
+	}
+}
\ No newline at end of file
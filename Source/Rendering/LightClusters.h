@@ -0,0 +1,76 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Core/Math.h"
+#include "Scene/Camera.h"
+#include "Scene/Light.h"
+
+// std430 layout of the Lights buffer in shadowMapping.frag, world space
+struct GpuLight {
+	glm::vec4 mPositionRange;
+	glm::vec4 mColor;	// rgb already scaled by the intensity
+	glm::vec4 mDirectionType;	// xyz spot direction, w the LightType
+	glm::vec4 mSpot;	// x inner cosine, y outer cosine
+};
+
+//---------------------------------------------------------------------------------
+// Clustered forward light culling. The view frustum is cut into a grid of tiles
+// in screen space and exponential slices in depth, and every light is binned on
+// the CPU into the clusters its bounding sphere touches. Slices are binned in
+// parallel on the job system, the sphere/box tests run 4 clusters at a time
+// with SSE. The result is one (offset, count) pair per cluster into a compact
+// light index list, which the lighting pass looks up per fragment.
+//---------------------------------------------------------------------------------
+class LightClusters {
+public:
+	// Also hardcoded in shadowMapping.frag
+	static constexpr uint32_t CLUSTERS_X = 16;
+	static constexpr uint32_t CLUSTERS_Y = 9;
+	static constexpr uint32_t CLUSTERS_Z = 24;
+	static constexpr uint32_t SLICE_CLUSTERS = CLUSTERS_X * CLUSTERS_Y;	// Multiple of 4 for the SSE loop
+	static constexpr uint32_t CLUSTER_COUNT = SLICE_CLUSTERS * CLUSTERS_Z;
+
+	void Init();
+
+	// Bins world space lights for this camera and uploads the lists, leaves the buffers bound to their binding points
+	void Update(const Camera& camera, const std::vector<Light>& lights);
+
+	// Cluster coordinate is floor(gl_FragCoord.xy * scale.xy) and floor(log(viewDepth) * scale.z + bias)
+	glm::vec3 GetScale(unsigned int screenWidth, unsigned int screenHeight) const;
+	float GetBias() const { return mSliceBias; }
+
+	uint32_t GetLightCount() const { return static_cast<uint32_t>(mGpuLights.size()); }
+	uint32_t GetIndexCount() const { return static_cast<uint32_t>(mIndices.size()); }
+private:
+	void buildClusterBounds(const Camera& camera);
+	void binSlice(uint32_t slice);
+
+	// View space bounding sphere per light, xyz center and w radius
+	std::vector<glm::vec4> mSpheres;
+	std::vector<GpuLight> mGpuLights;
+
+	// View space cluster boxes as structure of arrays, slice after slice
+	std::vector<float> mCenterX;
+	std::vector<float> mCenterY;
+	std::vector<float> mCenterZ;
+	std::vector<float> mExtentX;
+	std::vector<float> mExtentY;
+	std::vector<float> mExtentZ;
+	std::vector<float> mSliceDepths;	// CLUSTERS_Z + 1 boundaries, positive view depth
+	float mSliceScale = 0.0f;
+	float mSliceBias = 0.0f;
+	glm::vec4 mBoundsKey = glm::vec4(0.0f);	// fov, aspect, near, far the boxes were built for
+
+	std::vector<std::vector<uint32_t>> mClusterLights;	// Per cluster, capacity kept between frames
+	std::vector<glm::uvec2> mClusterRanges;	// Offset and count into mIndices
+	std::vector<uint32_t> mIndices;
+
+	unsigned int mLightBuffer = 0;
+	unsigned int mClusterBuffer = 0;
+	unsigned int mIndexBuffer = 0;
+};
+
+#endif
\ No newline at end of file
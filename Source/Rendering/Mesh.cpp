@@ -32,7 +32,18 @@ void MeshLoader::Load(const std::string& filepath, const std::string& name)
         else {
             modelMesh.subMeshes = std::move(topLevelMeshes);
         }
+        computeBounds(modelMesh);
         gResources.mMeshes.emplace(name, modelMesh);
+
+        GpuMesh gpuMesh;
+        gpuMesh.boundsMin = modelMesh.boundsMin;
+        gpuMesh.boundsMax = modelMesh.boundsMax;
+        gpuMesh.sphereCenter = modelMesh.sphereCenter;
+        gpuMesh.sphereRadius = modelMesh.sphereRadius;
+        gpuMesh.firstRecord = static_cast<unsigned int>(gResources.mDrawRecords.size());
+        collectDrawRecords(modelMesh, gResources.mDrawRecords);
+        gpuMesh.recordCount = static_cast<unsigned int>(gResources.mDrawRecords.size()) - gpuMesh.firstRecord;
+        gResources.mMeshHandles[name] = gResources.mGpuMeshes.Create(gpuMesh);
     }
 
     spdlog::info("Model '{}' loaded with {} top-level meshes.", name, topLevelMeshes.size());
@@ -42,7 +53,6 @@ Mesh MeshLoader::processMesh(aiMesh* mesh, const aiScene* scene)
 {
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
-    unsigned int vao, vbo, ebo;
 
     //-----------------------------------------------------------------------------
     // Vertices, normals, texture coordinates, and indices
@@ -89,53 +99,15 @@ Mesh MeshLoader::processMesh(aiMesh* mesh, const aiScene* scene)
     //std::vector<Texture> heightMaps = LoadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
 
     //-----------------------------------------------------------------------------
-    // Create buffers/arrays
+    // Upload into the shared geometry buffers
     //-----------------------------------------------------------------------------
-    // Generate and bind the Vertex Array Object
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
-
-    // Generate and bind the Vertex Buffer Object
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-    // Generate and bind the Element Buffer Object
-    glGenBuffers(1, &ebo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-    //-----------------------------------------------------------------------------
-    // Set vertex attributes pointers 
-    //-----------------------------------------------------------------------------
-    // Position 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-    glEnableVertexAttribArray(0);
-    // Normal
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-    glEnableVertexAttribArray(1);
-    // Texture Coord
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
-    glEnableVertexAttribArray(2);
-    // Color
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, color));
-    glEnableVertexAttribArray(3);
-    // Tangent
-    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tangent));
-    glEnableVertexAttribArray(4);
-    // Bitangent
-    glVertexAttribPointer(5, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, bitangent));
-    glEnableVertexAttribArray(5);
-
-    // Unbind VAO
-    glBindVertexArray(0);
+    const GeometryRange range = gResources.mGeometry.Allocate(vertices, indices);
 
     Mesh processedMesh;
     processedMesh.vertices = vertices;
     processedMesh.indices = indices;
-    processedMesh.vao = vao;
-    processedMesh.vbo = vbo;
-    processedMesh.ebo = ebo;
+    processedMesh.firstIndex = range.firstIndex;
+    processedMesh.baseVertex = range.baseVertex;
 
     return processedMesh;
 }
@@ -158,6 +130,74 @@ std::vector<Mesh> MeshLoader::processNode(aiNode* node, const aiScene* scene)
     return meshes;
 }
 
+//-----------------------------------------------------------------------------
+// AABB and bounding sphere of a mesh and, recursively, its submeshes. A parent's
+// bounds enclose its own vertices and all of its children.
+//-----------------------------------------------------------------------------
+void MeshLoader::computeBounds(Mesh& mesh)
+{
+    bool empty = true;
+    glm::vec3 boundsMin(0.0f);
+    glm::vec3 boundsMax(0.0f);
+
+    for (const Vertex& vertex : mesh.vertices) {
+        boundsMin = empty ? vertex.position : glm::min(boundsMin, vertex.position);
+        boundsMax = empty ? vertex.position : glm::max(boundsMax, vertex.position);
+        empty = false;
+    }
+
+    for (Mesh& subMesh : mesh.subMeshes) {
+        computeBounds(subMesh);
+        if (subMesh.vertices.empty() && subMesh.subMeshes.empty()) {
+            continue;
+        }
+        boundsMin = empty ? subMesh.boundsMin : glm::min(boundsMin, subMesh.boundsMin);
+        boundsMax = empty ? subMesh.boundsMax : glm::max(boundsMax, subMesh.boundsMax);
+        empty = false;
+    }
+
+    mesh.boundsMin = boundsMin;
+    mesh.boundsMax = boundsMax;
+    mesh.sphereCenter = (boundsMin + boundsMax) * 0.5f;
+
+    // Tighter than half the diagonal for most shapes
+    float radiusSquared = 0.0f;
+    for (const Vertex& vertex : mesh.vertices) {
+        const glm::vec3 offset = vertex.position - mesh.sphereCenter;
+        radiusSquared = glm::max(radiusSquared, glm::dot(offset, offset));
+    }
+    mesh.sphereRadius = glm::sqrt(radiusSquared);
+    for (const Mesh& subMesh : mesh.subMeshes) {
+        mesh.sphereRadius = glm::max(mesh.sphereRadius, glm::length(subMesh.sphereCenter - mesh.sphereCenter) + subMesh.sphereRadius);
+    }
+}
+
+void MeshLoader::collectDrawRecords(const Mesh& mesh, std::vector<DrawRecord>& records)
+{
+    if (!mesh.indices.empty()) {
+        DrawRecord record;
+        record.indexCount = static_cast<unsigned int>(mesh.indices.size());
+        record.firstIndex = mesh.firstIndex;
+        record.baseVertex = mesh.baseVertex;
+        record.boundsMin = mesh.boundsMin;
+        record.boundsMax = mesh.boundsMax;
+        records.push_back(record);
+    }
+
+    for (const Mesh& subMesh : mesh.subMeshes) {
+        collectDrawRecords(subMesh, records);
+    }
+}
+
 void LoadMesh(const std::string& filepath, const std::string& name) {
     MeshLoader::Load(filepath, name);
 }
+
+MeshHandle FindMesh(const std::string& name) {
+    auto it = gResources.mMeshHandles.find(name);
+    if (it == gResources.mMeshHandles.end()) {
+        spdlog::warn("MESH::FINDMESH: No mesh named '{}'", name);
+        return MeshHandle();
+    }
+    return it->second;
+}
@@ -5,6 +5,7 @@
 #include <vector>
 
 #include <Core/Math.h>
+#include <Core/Handle.h>
 
 struct aiMesh;
 struct aiScene;
@@ -20,20 +21,50 @@ struct Vertex {
 };
 
 struct Mesh {
-	unsigned int vao, vbo, ebo;
+	unsigned int firstIndex = 0;	// Offsets into gResources.mGeometry
+	int baseVertex = 0;
+	glm::vec3 boundsMin = glm::vec3(0.0f);	// Object space AABB, includes the submeshes
+	glm::vec3 boundsMax = glm::vec3(0.0f);
+	glm::vec3 sphereCenter = glm::vec3(0.0f);	// Bounding sphere around the AABB center
+	float sphereRadius = 0.0f;
 	std::vector<Vertex> vertices;
 	std::vector<unsigned int> indices;
 	std::vector<Mesh> subMeshes;
 };
 
+// Everything the render loop needs to issue one draw, without touching the CPU side mesh data
+// (all meshes share the VAO and buffers of gResources.mGeometry)
+struct DrawRecord {
+	unsigned int indexCount;
+	unsigned int firstIndex;
+	int baseVertex;
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+};
+
+// A loaded mesh on the GPU: a range in gResources.mDrawRecords, one record per submesh
+struct GpuMesh {
+	unsigned int firstRecord;
+	unsigned int recordCount;
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+	glm::vec3 sphereCenter;
+	float sphereRadius;
+};
+
+using MeshHandle = Handle<GpuMesh>;
+
 class MeshLoader {
 public:
 	static void Load(const std::string& filepath, const std::string& name);
 private:
 	static Mesh processMesh(aiMesh* mesh, const aiScene* scene);
 	static std::vector<Mesh> processNode(aiNode* node, const aiScene* scene);
+	static void computeBounds(Mesh& mesh);
+	static void collectDrawRecords(const Mesh& mesh, std::vector<DrawRecord>& records);
 };
 
 void LoadMesh(const std::string& filepath, const std::string& name);
+MeshHandle FindMesh(const std::string& name);
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,144 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Core/JobSystem.h"
+
+uint64_t RenderKey::Make(RenderPass pass, uint32_t program, uint32_t texture, uint32_t mesh, float depth01)
+{
+	const uint64_t depthMax = (uint64_t(1) << DEPTH_BITS) - 1;
+	const float clamped = std::min(std::max(depth01, 0.0f), 1.0f);
+	const uint64_t depth = static_cast<uint64_t>(clamped * static_cast<float>(depthMax));
+
+	return (uint64_t(static_cast<uint32_t>(pass)) << PASS_SHIFT) |
+		(uint64_t(program & ((1u << PROGRAM_BITS) - 1)) << PROGRAM_SHIFT) |
+		(uint64_t(texture & ((1u << TEXTURE_BITS) - 1)) << TEXTURE_SHIFT) |
+		(uint64_t(mesh & ((1u << MESH_BITS) - 1)) << MESH_SHIFT) |
+		(depth << DEPTH_SHIFT);
+}
+
+//-----------------------------------------------------------------------------
+// LSD radix sort, 8 bits per pass. All 8 histograms are built in one sweep and
+// passes where every key has the same byte are skipped, which is common for the
+// high bytes (pass/program) and makes the sort cheaper than it looks.
+//-----------------------------------------------------------------------------
+void CommandBuffer::Sort()
+{
+	const size_t count = mItems.size();
+	if (count < 2) {
+		return;
+	}
+
+	size_t histograms[8][256];
+	std::memset(histograms, 0, sizeof(histograms));
+	for (const RenderItem& item : mItems) {
+		for (int byte = 0; byte < 8; byte++) {
+			histograms[byte][(item.mKey >> (byte * 8)) & 0xFF]++;
+		}
+	}
+
+	mScratch.resize(count);
+	RenderItem* src = mItems.data();
+	RenderItem* dst = mScratch.data();
+	for (int byte = 0; byte < 8; byte++) {
+		size_t* histogram = histograms[byte];
+		const uint64_t firstByte = (src[0].mKey >> (byte * 8)) & 0xFF;
+		if (histogram[firstByte] == count) {
+			continue;
+		}
+
+		size_t offset = 0;
+		for (int bucket = 0; bucket < 256; bucket++) {
+			const size_t bucketCount = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += bucketCount;
+		}
+
+		for (size_t i = 0; i < count; i++) {
+			dst[histogram[(src[i].mKey >> (byte * 8)) & 0xFF]++] = src[i];
+		}
+		std::swap(src, dst);
+	}
+
+	if (src != mItems.data()) {
+		std::memcpy(mItems.data(), src, count * sizeof(RenderItem));
+	}
+}
+
+void RenderQueue::Reset(uint32_t count)
+{
+	if (mCommandBuffers.size() < count) {
+		mCommandBuffers.resize(count);
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		mCommandBuffers[i].Clear();
+	}
+	mCommandBufferCount = count;
+	mItems.clear();
+}
+
+//-----------------------------------------------------------------------------
+// The buffers are copied back to back, then neighbouring runs are merged in
+// rounds, each round halving the number of runs with one job per pair.
+// std::merge takes from the first run on ties, which keeps the result the
+// same as sorting everything recorded in buffer order.
+//-----------------------------------------------------------------------------
+void RenderQueue::Merge()
+{
+	mRuns.clear();
+	mRuns.push_back(0);
+	size_t total = 0;
+	for (uint32_t i = 0; i < mCommandBufferCount; i++) {
+		total += mCommandBuffers[i].GetItems().size();
+	}
+	mItems.resize(total);
+	for (uint32_t i = 0; i < mCommandBufferCount; i++) {
+		const std::vector<RenderItem>& items = mCommandBuffers[i].GetItems();
+		if (!items.empty()) {
+			std::memcpy(mItems.data() + mRuns.back(), items.data(), items.size() * sizeof(RenderItem));
+			mRuns.push_back(mRuns.back() + items.size());
+		}
+	}
+
+	mScratch.resize(total);
+	auto byKey = [](const RenderItem& a, const RenderItem& b) { return a.mKey < b.mKey; };
+	while (mRuns.size() > 2) {
+		const uint32_t runCount = static_cast<uint32_t>(mRuns.size() - 1);
+		gJobSystem.ParallelFor((runCount + 1) / 2, 1, [this, runCount, &byKey](uint32_t begin, uint32_t end) {
+			for (uint32_t pair = begin; pair < end; pair++) {
+				const size_t first = mRuns[pair * 2];
+				const size_t middle = mRuns[pair * 2 + 1];
+				const size_t last = pair * 2 + 2 <= runCount ? mRuns[pair * 2 + 2] : middle;
+				std::merge(mItems.begin() + first, mItems.begin() + middle, mItems.begin() + middle, mItems.begin() + last,
+					mScratch.begin() + first, byKey);
+			}
+		});
+		mItems.swap(mScratch);
+
+		size_t kept = 0;
+		for (size_t run = 0; run < mRuns.size(); run += 2) {
+			mRuns[kept++] = mRuns[run];
+		}
+		if (mRuns[kept - 1] != total) {
+			mRuns[kept++] = total;
+		}
+		mRuns.resize(kept);
+	}
+}
+
+void RenderQueue::GetPassRange(RenderPass pass, size_t& first, size_t& last) const
+{
+	const uint32_t passIndex = static_cast<uint32_t>(pass);
+	const uint64_t passBegin = uint64_t(passIndex) << RenderKey::PASS_SHIFT;
+
+	auto byKey = [](const RenderItem& item, uint64_t key) { return item.mKey < key; };
+	first = std::lower_bound(mItems.begin(), mItems.end(), passBegin, byKey) - mItems.begin();
+	if (passIndex + 1 == (1u << RenderKey::PASS_BITS)) {
+		last = mItems.size();
+		return;
+	}
+
+	const uint64_t passEnd = uint64_t(passIndex + 1) << RenderKey::PASS_SHIFT;
+	last = std::lower_bound(mItems.begin() + first, mItems.end(), passEnd, byKey) - mItems.begin();
+}
@@ -0,0 +1,93 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Also the submission order; the camera passes are kept adjacent so they cull as one range
+enum class RenderPass : uint8_t {
+	RENDER_PASS_SHADOW_STATIC = 0,	// Static casters, only into cached cascades that are out of date
+	RENDER_PASS_SHADOW = 1,
+	RENDER_PASS_DEPTH_PREPASS = 2,
+	RENDER_PASS_LIGHTING = 3,
+	RENDER_PASS_LIGHTING_EQUAL = 4	// Lighting for objects the prepass already laid depth down for
+};
+
+//---------------------------------------------------------------------------------
+// 64 bit sort key, most significant field first so sorting the keys groups draws
+// by the state that is most expensive to change:
+// | pass 3 | program 8 | texture 12 | mesh 16 | depth 25 |
+//---------------------------------------------------------------------------------
+namespace RenderKey {
+	constexpr uint32_t PASS_BITS = 3;
+	constexpr uint32_t PROGRAM_BITS = 8;
+	constexpr uint32_t TEXTURE_BITS = 12;
+	constexpr uint32_t MESH_BITS = 16;
+	constexpr uint32_t DEPTH_BITS = 25;
+
+	constexpr uint32_t DEPTH_SHIFT = 0;
+	constexpr uint32_t MESH_SHIFT = DEPTH_SHIFT + DEPTH_BITS;
+	constexpr uint32_t TEXTURE_SHIFT = MESH_SHIFT + MESH_BITS;
+	constexpr uint32_t PROGRAM_SHIFT = TEXTURE_SHIFT + TEXTURE_BITS;
+	constexpr uint32_t PASS_SHIFT = PROGRAM_SHIFT + PROGRAM_BITS;
+
+	uint64_t Make(RenderPass pass, uint32_t program, uint32_t texture, uint32_t mesh, float depth01);
+
+	inline uint32_t Field(uint64_t key, uint32_t shift, uint32_t bits) {
+		return static_cast<uint32_t>((key >> shift) & ((uint64_t(1) << bits) - 1));
+	}
+	inline RenderPass Pass(uint64_t key) { return static_cast<RenderPass>(Field(key, PASS_SHIFT, PASS_BITS)); }
+	inline uint32_t Program(uint64_t key) { return Field(key, PROGRAM_SHIFT, PROGRAM_BITS); }
+	inline uint32_t Texture(uint64_t key) { return Field(key, TEXTURE_SHIFT, TEXTURE_BITS); }
+	inline uint32_t Mesh(uint64_t key) { return Field(key, MESH_SHIFT, MESH_BITS); }
+}
+
+// Draw packet: everything about a draw is in the key, the object picks the instance data
+struct RenderItem {
+	uint64_t mKey;
+	uint32_t mObject;	// index into the snapshot objects
+};
+
+//---------------------------------------------------------------------------------
+// Linear list of draw packets recorded by one job. Only the thread running that
+// job writes to it, and it is radix sorted by the same job once recording is done.
+//---------------------------------------------------------------------------------
+class CommandBuffer {
+public:
+	void Clear() { mItems.clear(); }
+	void Push(uint64_t key, uint32_t object) { mItems.push_back({ key, object }); }
+	void Sort();
+
+	const std::vector<RenderItem>& GetItems() const { return mItems; }
+private:
+	std::vector<RenderItem> mItems;
+	std::vector<RenderItem> mScratch;
+};
+
+//---------------------------------------------------------------------------------
+// Filled with one item per visible object per pass every frame. Recording jobs
+// each write their own command buffer, Merge() then combines the sorted buffers
+// into one key ordered list, so submission only has to touch GL state when a
+// key field changes. Equal keys keep the order of the buffers they came from.
+//---------------------------------------------------------------------------------
+class RenderQueue {
+public:
+	// Clears the first count command buffers, one per recording job
+	void Reset(uint32_t count);
+	CommandBuffer& GetCommandBuffer(uint32_t index) { return mCommandBuffers[index]; }
+	// Merges the sorted command buffers in pairs on the job system until one list is left
+	void Merge();
+
+	// Items of one pass as [first, last) into GetItems()
+	void GetPassRange(RenderPass pass, size_t& first, size_t& last) const;
+	const std::vector<RenderItem>& GetItems() const { return mItems; }
+private:
+	std::vector<CommandBuffer> mCommandBuffers;
+	uint32_t mCommandBufferCount = 0;
+	std::vector<RenderItem> mItems;
+	std::vector<RenderItem> mScratch;
+	std::vector<size_t> mRuns;	// Boundaries of the sorted runs left to merge
+};
+
+#endif
@@ -0,0 +1,43 @@
+#include "RenderSnapshot.h"
+
+#include "Scene/Scene.h"
+
+void BuildRenderSnapshot(RenderSnapshot& snapshot, uint64_t frame)
+{
+	snapshot.mFrame = frame;
+	snapshot.mCamera = *gScene.camera.get();
+
+	// Slots are reused, so everything is written again, but the vectors keep their capacity
+	const uint32_t objectCount = static_cast<uint32_t>(gScene.objects.size());
+	snapshot.mObjects.resize(objectCount);
+	snapshot.mWorldMatrices.resize(objectCount);
+	for (uint32_t i = 0; i < objectCount; i++) {
+		const GameObject& object = *gScene.objects[i];
+		RenderObject& renderObject = snapshot.mObjects[i];
+		renderObject.mMesh = object.GetMesh();
+		renderObject.mTexture = object.GetTexture();
+		renderObject.mType = object.GetStaticType();
+		snapshot.mWorldMatrices[i] = gScene.transforms.GetWorldMatrix(object.GetTransform());
+	}
+
+	snapshot.mChangedObjects.clear();
+	for (uint32_t transform : gScene.transforms.GetChanged()) {
+		const uint32_t object = transform < gScene.transformObjects.size() ? gScene.transformObjects[transform] : INVALID_OBJECT;
+		if (object < objectCount) {
+			snapshot.mChangedObjects.push_back(object);
+		}
+	}
+
+	snapshot.mLights = gScene.lights;
+	for (Light& light : snapshot.mLights) {
+		if (light.mTransform == INVALID_TRANSFORM) {
+			continue;
+		}
+		const glm::mat4& world = gScene.transforms.GetWorldMatrix(light.mTransform);
+		light.mPosition = glm::vec3(world * glm::vec4(light.mPosition, 1.0f));
+		light.mDirection = glm::mat3(world) * light.mDirection;
+		light.mTransform = INVALID_TRANSFORM;
+	}
+
+	snapshot.mApplyShadowSettings = false;
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#ifndef RENDER_SNAPSHOT_H
+#define RENDER_SNAPSHOT_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Core/Math.h"
+#include "Rendering/Mesh.h"
+#include "Rendering/Renderer.h"
+#include "Rendering/Texture.h"
+#include "Scene/Camera.h"
+#include "Scene/GameObject.h"
+#include "Scene/Light.h"
+
+// What the renderer needs from one scene object
+struct RenderObject {
+	MeshHandle mMesh;
+	TextureHandle mTexture;
+	ObjectType mType = ObjectType::OBJECT_TYPE_NONE;
+};
+
+//---------------------------------------------------------------------------------
+// Everything the renderer reads about one frame, copied out of gScene by the
+// main thread and left untouched while the render thread draws it. Objects
+// keep their gScene.objects index so the renderer's per object state (bounds,
+// scene buffer slots) stays valid from one snapshot to the next.
+//---------------------------------------------------------------------------------
+struct RenderSnapshot {
+	uint64_t mFrame = 0;
+	Camera mCamera;
+	std::vector<RenderObject> mObjects;
+	std::vector<glm::mat4> mWorldMatrices;	// Per object
+	std::vector<uint32_t> mChangedObjects;	// World matrix changed since the previous snapshot
+	std::vector<Light> mLights;	// World space, transforms already applied
+	bool mApplyShadowSettings = false;	// Settings changed on the main thread, applied before the frame renders
+	ShadowSettings mShadowSettings;
+};
+
+// Fills the snapshot from gScene, after UpdateScene
+void BuildRenderSnapshot(RenderSnapshot& snapshot, uint64_t frame);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,122 @@
+#include "RenderThread.h"
+
+#include "Log/Logger.h"
+#include "Rendering/GLState.h"
+#include "Rendering/Renderer.h"
+
+RenderSnapshot* SnapshotRing::BeginWrite()
+{
+	const uint32_t write = mWrite.load(std::memory_order_relaxed);
+	const uint32_t read = mRead.load(std::memory_order_acquire);
+	if (write - read >= CAPACITY) {
+		return nullptr;
+	}
+	return &mSlots[write % CAPACITY];
+}
+
+void SnapshotRing::EndWrite()
+{
+	mWrite.store(mWrite.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+const RenderSnapshot* SnapshotRing::BeginRead()
+{
+	const uint32_t read = mRead.load(std::memory_order_relaxed);
+	const uint32_t write = mWrite.load(std::memory_order_acquire);
+	if (read == write) {
+		return nullptr;
+	}
+	return &mSlots[read % CAPACITY];
+}
+
+void SnapshotRing::EndRead()
+{
+	mRead.store(mRead.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void RenderThread::Start(SDL_Window* window, SDL_GLContext context)
+{
+	mWindow = window;
+	mContext = context;
+	mRunning.store(true, std::memory_order_release);
+	mThread = std::thread(&RenderThread::run, this);
+}
+
+void RenderThread::Stop()
+{
+	mRunning.store(false, std::memory_order_release);
+	signal();
+	if (mThread.joinable()) {
+		mThread.join();
+	}
+	SDL_GL_MakeCurrent(mWindow, mContext);
+	gGLState.Invalidate();
+}
+
+RenderSnapshot& RenderThread::BeginSnapshot()
+{
+	RenderSnapshot* snapshot = mRing.BeginWrite();
+	if (!snapshot) {
+		std::unique_lock<std::mutex> lock(mWaitMutex);
+		mWake.wait(lock, [this, &snapshot] { return (snapshot = mRing.BeginWrite()) != nullptr; });
+	}
+	return *snapshot;
+}
+
+void RenderThread::SubmitSnapshot()
+{
+	mRing.EndWrite();
+	signal();
+}
+
+//-----------------------------------------------------------------------------
+// Taking the mutex between the ring update and the notify closes the gap where
+// a waiter has checked the ring but not started waiting yet, which would lose
+// the wake up.
+//-----------------------------------------------------------------------------
+void RenderThread::signal()
+{
+	{
+		std::lock_guard<std::mutex> lock(mWaitMutex);
+	}
+	mWake.notify_all();
+}
+
+void RenderThread::run()
+{
+	// Without the context snapshots are still consumed, so the main thread never waits forever
+	const bool current = SDL_GL_MakeCurrent(mWindow, mContext) == 0;
+	if (!current) {
+		spdlog::error("RENDERTHREAD::RUN: Failed to take the GL context {}", SDL_GetError());
+	}
+	// Whatever the main thread left bound is unknown from here on
+	gGLState.Invalidate();
+
+	for (;;) {
+		// Read before looking at the ring, a stop is only seen after every snapshot published before it
+		const RenderSnapshot* snapshot = nullptr;
+		auto ready = [this, &snapshot] {
+			const bool running = mRunning.load(std::memory_order_acquire);
+			snapshot = mRing.BeginRead();
+			return snapshot || !running;
+		};
+		if (!ready()) {
+			std::unique_lock<std::mutex> lock(mWaitMutex);
+			mWake.wait(lock, ready);
+		}
+		if (!snapshot) {
+			break;
+		}
+
+		if (current) {
+			mRenderTimer.Begin();
+			Renderer::RenderScene(*snapshot);
+			mRenderTimer.End();
+			SDL_GL_SwapWindow(mWindow);
+		}
+		mRing.EndRead();
+		signal();
+	}
+
+	SDL_GL_MakeCurrent(mWindow, nullptr);
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#ifndef RENDER_THREAD_H
+#define RENDER_THREAD_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include <SDL.h>
+
+#include "Core/Benchmark.h"
+#include "Rendering/RenderSnapshot.h"
+
+//---------------------------------------------------------------------------------
+// Bounded single producer, single consumer ring of snapshots. The main thread
+// fills the slot at the write index and publishes it, the render thread reads
+// the slot at the read index and hands it back when the frame is submitted.
+// Both indices only grow and each is stored by one side only, so no locks are
+// needed. CAPACITY has to be a power of two for the wrap around to work.
+//---------------------------------------------------------------------------------
+class SnapshotRing {
+public:
+	// Two slots: the main thread fills frame N+1 while frame N is submitted
+	static constexpr uint32_t CAPACITY = 2;
+
+	// nullptr while every slot is queued or being rendered
+	RenderSnapshot* BeginWrite();
+	void EndWrite();
+
+	// nullptr while nothing was published
+	const RenderSnapshot* BeginRead();
+	void EndRead();
+private:
+	RenderSnapshot mSlots[CAPACITY];
+	std::atomic<uint32_t> mWrite{ 0 };	// Snapshots published
+	std::atomic<uint32_t> mRead{ 0 };	// Snapshots the render thread is done with
+};
+
+//---------------------------------------------------------------------------------
+// Owns the GL context while it runs: renders and presents every snapshot the
+// main thread submits, in order, so simulation of the next frame overlaps GL
+// submission of the current one. The ring itself stays lock free, the mutex
+// and condition variable are only there so a side with nothing to do sleeps
+// instead of spinning a core the job system's workers could use.
+//---------------------------------------------------------------------------------
+class RenderThread {
+public:
+	// The calling thread has to release the context first
+	void Start(SDL_Window* window, SDL_GLContext context);
+	// Renders what is still queued, then makes the context current on the calling thread again
+	void Stop();
+
+	// Main thread: slot for the next snapshot, waits while the render thread is a frame behind
+	RenderSnapshot& BeginSnapshot();
+	void SubmitSnapshot();
+
+	const FrameTimer& GetTimer() const { return mRenderTimer; }
+private:
+	void run();
+	// Wakes whichever side waits on the ring, after it changed or a stop was requested
+	void signal();
+
+	SDL_Window* mWindow = nullptr;
+	SDL_GLContext mContext = nullptr;
+	std::thread mThread;
+	std::atomic<bool> mRunning{ false };
+	SnapshotRing mRing;
+	std::mutex mWaitMutex;
+	std::condition_variable mWake;
+	FrameTimer mRenderTimer;	// Only touched by the render thread until Stop returns
+};
+
+#endif
\ No newline at end of file
@@ -1,39 +1,179 @@
 #include "Renderer.h"
 
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <string>
+
 #include <glad/glad.h>
 
 #include "Log/Logger.h"
+#include "Core/JobSystem.h"
 #include "Core/Resources.h"
+#include "Rendering/Bindings.h"
+#include "Rendering/GLState.h"
 #include "Rendering/Mesh.h"
+#include "Rendering/RenderSnapshot.h"
 #include "Rendering/Shader.h"
 #include "Rendering/Texture.h"
 #include "Scene/Scene.h"
 
-// TODO: Create a file with util/helper functions to make he buffers n shit
-void Renderer::Init()
+static void bindTextureArray(uint32_t array)
+{
+	const TextureArray* textureArray = array < gResources.mTextureArrays.size() ? &gResources.mTextureArrays[array] : nullptr;
+	gGLState.BindTexture(0, GL_TEXTURE_2D_ARRAY, textureArray ? textureArray->mId : 0);
+}
+
+//-----------------------------------------------------------------------------
+// Draws one pass worth of batches. Each command draws every instance of one
+// (mesh, texture) group, the vertex shaders find the object through the
+// instance buffer and the texture layer through the material buffer. Program
+// and texture array are set per batch, gGLState drops the ones that did not
+// change. Depth only passes just fetch positions, so they draw from the packed
+// position stream.
+//-----------------------------------------------------------------------------
+static void submitPass(RenderPass pass, bool bindTextures)
+{
+	const GeometryBuffer& geometry = gResources.mGeometry;
+	const bool shaded = pass == RenderPass::RENDER_PASS_LIGHTING || pass == RenderPass::RENDER_PASS_LIGHTING_EQUAL;
+	gGLState.BindVertexArray(shaded ? geometry.GetVertexArray() : geometry.GetPositionVertexArray());
+	if (renderData.mGpuCulling) {
+		renderData.mCulling.BindForDraw();
+	}
+	else {
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, renderData.mIndirectBuffer);
+		gGLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_INSTANCES, renderData.mInstanceBuffer);
+	}
+
+	for (const DrawBatch& batch : renderData.mDrawBatches) {
+		if (batch.mPass != pass) {
+			continue;
+		}
+		gGLState.UseProgram(gResources.mProgramTable[batch.mProgram]->mId);
+		if (bindTextures) {
+			bindTextureArray(batch.mTextureArray);
+		}
+
+		if (renderData.mMultiDrawIndirect) {
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+				(void*)(batch.mFirstCommand * sizeof(DrawElementsIndirectCommand)), batch.mCommandCount, 0);
+			renderData.mStats.mDrawCalls++;
+		}
+		else {
+			for (uint32_t i = batch.mFirstCommand; i < batch.mFirstCommand + batch.mCommandCount; ++i) {
+				const DrawElementsIndirectCommand& command = renderData.mDrawCommands[i];
+				glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, command.mCount, GL_UNSIGNED_INT,
+					(void*)(command.mFirstIndex * sizeof(GLuint)), command.mInstanceCount, command.mBaseVertex, command.mBaseInstance);
+			}
+			renderData.mStats.mDrawCalls += batch.mCommandCount;
+		}
+		renderData.mStats.mDrawCommands += batch.mInstanceCount;
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+// Batches are sorted by pass, so adjacent passes own one contiguous run of commands and instances
+CullRange Renderer::GetPassRange(RenderPass first, RenderPass last)
+{
+	CullRange range;
+	for (const DrawBatch& batch : renderData.mDrawBatches) {
+		if (batch.mPass < first || batch.mPass > last) {
+			continue;
+		}
+		if (range.mCommandCount == 0) {
+			range.mFirstCommand = batch.mFirstCommand;
+			range.mFirstInstance = batch.mFirstInstance;
+		}
+		range.mCommandCount += batch.mCommandCount;
+		range.mInstanceCount += batch.mInstanceCount;
+	}
+	return range;
+}
+
+ShadowSettings GetShadowQualitySettings(ShadowQuality quality)
+{
+	ShadowSettings settings;
+	switch (quality) {
+	case SHADOW_QUALITY_LOW:
+		settings.mResolution = Resolution::MEDIUM;
+		settings.mCascadeCount = 3;
+		settings.mDepthFormat = SHADOW_DEPTH_16;
+		settings.mFilter = SHADOW_FILTER_SINGLE;
+		break;
+	case SHADOW_QUALITY_MEDIUM:
+		settings.mResolution = Resolution::MEDIUM;
+		settings.mCascadeCount = 4;
+		settings.mDepthFormat = SHADOW_DEPTH_24;
+		settings.mFilter = SHADOW_FILTER_GATHER;
+		break;
+	case SHADOW_QUALITY_ULTRA:
+		settings.mResolution = Resolution::ULTRA;
+		settings.mCascadeCount = 5;
+		settings.mDepthFormat = SHADOW_DEPTH_32F;
+		break;
+	default:
+		break;
+	}
+	return settings;
+}
+
+const char* GetShadowDepthFormatName(ShadowDepthFormat format)
+{
+	switch (format) {
+	case SHADOW_DEPTH_24: return "24 bit";
+	case SHADOW_DEPTH_16: return "16 bit";
+	default: return "32 bit float";
+	}
+}
+
+static GLenum shadowInternalFormat(ShadowDepthFormat format)
 {
-	renderData.mShadowCascadeLevels = { gScene.camera.get()->GetFarPlane() / 50.0f, gScene.camera.get()->GetFarPlane() / 25.0f, gScene.camera.get()->GetFarPlane() / 10.0f, gScene.camera.get()->GetFarPlane() / 2.0f };
+	switch (format) {
+	case SHADOW_DEPTH_24: return GL_DEPTH_COMPONENT24;
+	case SHADOW_DEPTH_16: return GL_DEPTH_COMPONENT16;
+	default: return GL_DEPTH_COMPONENT32F;
+	}
+}
+
+// 24 bit depth is stored in 32 bits by every driver we care about
+static uint64_t shadowTexelBytes(ShadowDepthFormat format)
+{
+	return format == SHADOW_DEPTH_16 ? 2 : 4;
+}
+
+//-----------------------------------------------------------------------------
+// (Re)creates the shadow map and static cache arrays with one layer per
+// cascade at the current resolution and depth format, and attaches them to
+// their framebuffers.
+//-----------------------------------------------------------------------------
+static void createShadowMaps()
+{
+	const GLsizei layers = GLsizei(renderData.mCascadeCount);
+	const GLenum internalFormat = shadowInternalFormat(renderData.mShadowDepthFormat);
+	glDeleteTextures(1, &renderData.mLightDepthMaps);
+	glDeleteTextures(1, &renderData.mStaticDepthMaps);
+	gGLState.ForgetTexture(renderData.mLightDepthMaps);
+	gGLState.ForgetTexture(renderData.mStaticDepthMaps);
 	////-----------------------------------------------------------------------------
 	//// Configure light frame buffer
 	////-----------------------------------------------------------------------------
-	glGenFramebuffers(1, &renderData.mLightFrameBuffer);
-
 	glGenTextures(1, &renderData.mLightDepthMaps);
-	glBindTexture(GL_TEXTURE_2D_ARRAY, renderData.mLightDepthMaps);
-	glTexImage3D(
-		GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, 
-		renderData.mDepthMapResolution, renderData.mDepthMapResolution, int(renderData.mShadowCascadeLevels.size()) + 1,
-		0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+	gGLState.BindTexture(0, GL_TEXTURE_2D_ARRAY, renderData.mLightDepthMaps);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, internalFormat,
+		renderData.mDepthMapResolution, renderData.mDepthMapResolution, layers);
 
-	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	// Sampled through sampler2DArrayShadow, linear filtering makes each compare a 2x2 PCF
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
 	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
 	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
 
 	constexpr float bordercolor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
 	glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, bordercolor);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, renderData.mLightFrameBuffer);
+	gGLState.BindFramebuffer(GL_FRAMEBUFFER, renderData.mLightFrameBuffer);
 	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, renderData.mLightDepthMaps, 0);
 	glDrawBuffer(GL_NONE);
 	glReadBuffer(GL_NONE);
@@ -44,28 +184,694 @@ void Renderer::Init()
 		spdlog::error("RENDERER::INIT: Framebuffer is not complete!");
 		throw 0;
 	}
+	////-----------------------------------------------------------------------------
+	//// Configure static shadow cache, same layout so layers can be copied across
+	////-----------------------------------------------------------------------------
+	glGenTextures(1, &renderData.mStaticDepthMaps);
+	gGLState.BindTexture(0, GL_TEXTURE_2D_ARRAY, renderData.mStaticDepthMaps);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, internalFormat,
+		renderData.mDepthMapResolution, renderData.mDepthMapResolution, layers);
+	// glCopyImageSubData wants a complete texture
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	gGLState.BindTexture(0, GL_TEXTURE_2D_ARRAY, 0);
+
+	gGLState.BindFramebuffer(GL_FRAMEBUFFER, renderData.mStaticFrameBuffer);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, renderData.mStaticDepthMaps, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+
+	status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		spdlog::error("RENDERER::INIT: Static shadow framebuffer is not complete!");
+		throw 0;
+	}
+
+	gGLState.BindFramebuffer(GL_FRAMEBUFFER, 0);
+	renderData.mStaticCacheValid = false;
+	renderData.mCascadesInvalid = true;
+
+	const bool moments = renderData.mShadowTechnique == SHADOW_TECHNIQUE_EVSM;
+	renderData.mShadowMoments.Resize(renderData.mDepthMapResolution, moments ? layers : 0,
+		renderData.mShadowDepthFormat != SHADOW_DEPTH_16);
+}
+
+//-----------------------------------------------------------------------------
+// Split distances for count cascades over [mShadowNear, mShadowFar], blending
+// logarithmic and uniform splits (practical split scheme). Over the full camera
+// range with 5 cascades this lands close to the old fixed far / 50, 25, 10 splits.
+//-----------------------------------------------------------------------------
+static std::vector<float> computeCascadeLevels(unsigned int count)
+{
+	constexpr float lambda = 0.9f;
+	const float nearPlane = renderData.mShadowNear;
+	const float farPlane = renderData.mShadowFar;
+
+	std::vector<float> levels;
+	for (unsigned int i = 1; i < count; ++i) {
+		const float fraction = float(i) / float(count);
+		const float logSplit = nearPlane * std::pow(farPlane / nearPlane, fraction);
+		const float uniformSplit = nearPlane + (farPlane - nearPlane) * fraction;
+		levels.push_back(lambda * logSplit + (1.0f - lambda) * uniformSplit);
+	}
+	return levels;
+}
+
+//-----------------------------------------------------------------------------
+// Reallocates the shadow maps with new settings. Everything that depends on
+// them follows: split distances, the geometry shader's invocation count, the
+// lighting shader's filter kernel and the static cache, which starts over.
+// Nothing else has to be recreated, the passes read the resolution and layer
+// count every frame.
+//-----------------------------------------------------------------------------
+static void applyShadowSettings(const ShadowSettings& settings)
+{
+	const bool firstTime = renderData.mLightDepthMaps == 0;
+	const unsigned int count = std::max(1u, std::min(settings.mCascadeCount, GpuCulling::MAX_CASCADES));
+	const bool countChanged = count != renderData.mCascadeCount || firstTime;
+	const bool lightingChanged = settings.mFilter != renderData.mShadowFilter || settings.mTechnique != renderData.mShadowTechnique ||
+		(settings.mDepthFormat == SHADOW_DEPTH_16) != (renderData.mShadowDepthFormat == SHADOW_DEPTH_16) || firstTime;
+	// Tiers and --shadow-quality never ask the driver, its limit wins over whatever was requested
+	GLint maxTextureSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+	const unsigned int resolution = std::min(std::max(1u, settings.mResolution), static_cast<unsigned int>(std::max(maxTextureSize, 1)));
+	if (resolution != settings.mResolution) {
+		spdlog::warn("RENDERER::SHADOWS: {} shadow maps are over the {} GL_MAX_TEXTURE_SIZE, clamped", settings.mResolution, maxTextureSize);
+	}
+	renderData.mDepthMapResolution = resolution;
+	renderData.mShadowDepthFormat = settings.mDepthFormat;
+	renderData.mShadowFilter = settings.mFilter;
+	renderData.mShadowTechnique = settings.mTechnique;
+	renderData.mCascadeCount = count;
+	renderData.mShadowCascadeLevels = computeCascadeLevels(count);
+	createShadowMaps();
+
+	if (countChanged) {
+		ShaderProgram& depthProgram = gResources.mShaderPrograms.at("depth");
+		depthProgram.SetDefine("CASCADE_COUNT", std::to_string(count));
+		depthProgram.Rebuild();
+	}
+
+	if (lightingChanged) {
+		// Uniform handles and block bindings carry over the rebuild, sampler units do not
+		ShaderProgram& program = gResources.mShaderPrograms.at("shadow");
+		program.SetDefine("SHADOW_FILTER", std::to_string(int(settings.mFilter)));
+		program.SetDefine("SHADOW_TECHNIQUE", std::to_string(int(settings.mTechnique)));
+		program.SetDefine("SHADOW_MOMENTS_32F", settings.mDepthFormat != SHADOW_DEPTH_16 ? "1" : "0");
+		program.Rebuild();
+		gGLState.UseProgram(program.mId);
+		program.SetUniformInt("diffuseTextures", 0);
+		program.SetUniformInt("shadowMap", 1);
+		program.SetUniformInt("shadowMoments", 2);
+	}
+
+	spdlog::info("RENDERER::SHADOWS: {}x{}, {} cascades, {} depth, {:.1f} MB", renderData.mDepthMapResolution, renderData.mDepthMapResolution,
+		count, GetShadowDepthFormatName(renderData.mShadowDepthFormat), Renderer::GetShadowMemoryStats().GetTotalBytes() / (1024.0 * 1024.0));
+}
+
+void Renderer::SetShadowSettings(const ShadowSettings& settings)
+{
+	const ShadowSettings current = GetShadowSettings();
+	if (settings.mResolution == current.mResolution && settings.mCascadeCount == current.mCascadeCount &&
+		settings.mDepthFormat == current.mDepthFormat && settings.mFilter == current.mFilter && settings.mTechnique == current.mTechnique) {
+		return;
+	}
+	applyShadowSettings(settings);
+}
+
+void Renderer::SetCascadeCount(unsigned int count)
+{
+	ShadowSettings settings = GetShadowSettings();
+	settings.mCascadeCount = count;
+	SetShadowSettings(settings);
+}
+
+ShadowSettings Renderer::GetShadowSettings()
+{
+	ShadowSettings settings;
+	settings.mResolution = renderData.mDepthMapResolution;
+	settings.mCascadeCount = renderData.mCascadeCount;
+	settings.mDepthFormat = renderData.mShadowDepthFormat;
+	settings.mFilter = renderData.mShadowFilter;
+	settings.mTechnique = renderData.mShadowTechnique;
+	return settings;
+}
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+ShadowMemoryStats Renderer::GetShadowMemoryStats()
+{
+	const uint64_t resolution = renderData.mDepthMapResolution;
+	const uint64_t layerBytes = resolution * resolution * shadowTexelBytes(renderData.mShadowDepthFormat);
+
+	ShadowMemoryStats stats;
+	stats.mShadowMapBytes = renderData.mLightDepthMaps ? layerBytes * renderData.mCascadeCount : 0;
+	stats.mStaticCacheBytes = renderData.mStaticDepthMaps ? layerBytes * renderData.mCascadeCount : 0;
+	stats.mMomentBytes = renderData.mShadowMoments.GetMemoryBytes();
+	return stats;
+}
+
+// TODO: Create a file with util/helper functions to make he buffers n shit
+void Renderer::Init()
+{
+	// Layered shadows need gl_Layer in the vertex shader, otherwise the geometry shader fans out
+	renderData.mVertexLayer = renderData.mVertexLayer && gResources.mShaderPrograms.count("depthLayered") != 0;
+	spdlog::info("RENDERER::INIT: Shadow cascades through {}", renderData.mVertexLayer ? "vertex shader layer" : "geometry shader");
+
+	renderData.mShadowNear = gScene.camera.get()->GetNearPlane();
+	renderData.mShadowFar = gScene.camera.get()->GetFarPlane();
+	glGenFramebuffers(1, &renderData.mLightFrameBuffer);
+	glGenFramebuffers(1, &renderData.mStaticFrameBuffer);
+	// Bound once, Rebuild() keeps block bindings across every relink applyShadowSettings does
+	gResources.mShaderPrograms.at("depth").BindUniformBlock("LightSpaceMatrices", BINDING_LIGHT_SPACE_MATRICES);
+	gResources.mShaderPrograms.at("shadow").BindUniformBlock("LightSpaceMatrices", BINDING_LIGHT_SPACE_MATRICES);
+	applyShadowSettings(GetShadowSettings());
 	////-----------------------------------------------------------------------------
 	//// Configure uniform buffer
 	////-----------------------------------------------------------------------------
 	glGenBuffers(1, &renderData.mMatricesUniformBuffer);
 	glBindBuffer(GL_UNIFORM_BUFFER, renderData.mMatricesUniformBuffer);
 	glBufferData(GL_UNIFORM_BUFFER, sizeof(glm::mat4x4) * 16, nullptr, GL_STATIC_DRAW);
-	glBindBufferBase(GL_UNIFORM_BUFFER, 0, renderData.mMatricesUniformBuffer);
+	gGLState.BindBufferBase(GL_UNIFORM_BUFFER, BINDING_LIGHT_SPACE_MATRICES, renderData.mMatricesUniformBuffer);
 	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 	////-----------------------------------------------------------------------------
+	//// Configure indirect draw and instance buffers
+	////-----------------------------------------------------------------------------
+	glGenBuffers(1, &renderData.mIndirectBuffer);
+	glGenBuffers(1, &renderData.mInstanceBuffer);
+	////-----------------------------------------------------------------------------
+	//// Configure scene buffer and cascade masks
+	////-----------------------------------------------------------------------------
+	glGenBuffers(1, &renderData.mCascadeMaskBuffer);
+	glGenBuffers(1, &renderData.mStaticCascadeMaskBuffer);
+	renderData.mGpuCulling = renderData.mGpuCulling && renderData.mMultiDrawIndirect;
+	renderData.mSceneBuffer.Init();
+	gGLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_MATERIALS, gResources.mMaterialBuffer);
+	renderData.mCulling.Init(renderData.mScreenWidth, renderData.mScreenHeight);
+	renderData.mDepthReduction.Init();
+	renderData.mLightClusters.Init();
+	////-----------------------------------------------------------------------------
 	//// Shader configuration
 	////-----------------------------------------------------------------------------
+	// Block binding and sampler units were set before and by applyShadowSettings
 	ShaderProgram& program = gResources.mShaderPrograms.at("shadow");
-	glUseProgram(program.mId);
-	program.SetUniformInt("diffuseTexture", 0);
-	program.SetUniformInt("shadowMap", 1);
+	LightingUniforms& uniforms = renderData.mLightingUniforms;
+	uniforms.mProjection = program.GetUniform<glm::mat4>("projection");
+	uniforms.mView = program.GetUniform<glm::mat4>("view");
+	uniforms.mViewPos = program.GetUniform<glm::vec3>("viewPos");
+	uniforms.mLightDir = program.GetUniform<glm::vec3>("lightDir");
+	uniforms.mCascadePlaneDistances = program.GetUniform<float>("cascadePlaneDistances");
+	uniforms.mClusterScale = program.GetUniform<glm::vec3>("clusterScale");
+	uniforms.mClusterBias = program.GetUniform<float>("clusterBias");
+
+	ShaderProgram& prepassProgram = gResources.mShaderPrograms.at("prepass");
+	renderData.mDepthPrepassUniforms.mProjection = prepassProgram.GetUniform<glm::mat4>("projection");
+	renderData.mDepthPrepassUniforms.mView = prepassProgram.GetUniform<glm::mat4>("view");
+	////-----------------------------------------------------------------------------
+	//// Overdraw statistics
+	////-----------------------------------------------------------------------------
+	glGenQueries(RendererData::OVERDRAW_QUERY_FRAMES, renderData.mOverdrawQueries);
+}
+
+//-----------------------------------------------------------------------------
+// Moves the cascades onto the depth range the last finished reduction found.
+// The range is widened to steps of 2^(1/8) so the splits, and with them the
+// static cache, only change when the visible range really grows or shrinks,
+// and the frame of latency rarely shows geometry outside the cascades.
+//-----------------------------------------------------------------------------
+static void fitCascadesToDepth()
+{
+	float nearDepth, farDepth;
+	if (!renderData.mSampleDistribution || !renderData.mDepthReduction.Resolve(nearDepth, farDepth)) {
+		return;
+	}
+
+	const Camera& camera = renderData.mSnapshot->mCamera;
+	nearDepth = std::max(camera.GetNearPlane(), std::exp2(std::floor(std::log2(nearDepth) * 8.0f) / 8.0f));
+	farDepth = std::min(camera.GetFarPlane(), std::exp2(std::ceil(std::log2(farDepth) * 8.0f) / 8.0f));
+	if (farDepth <= nearDepth || (nearDepth == renderData.mShadowNear && farDepth == renderData.mShadowFar)) {
+		return;
+	}
+
+	renderData.mShadowNear = nearDepth;
+	renderData.mShadowFar = farDepth;
+	renderData.mShadowCascadeLevels = computeCascadeLevels(renderData.mCascadeCount);
+	renderData.mCascadesInvalid = true;
+}
+
+//-----------------------------------------------------------------------------
+// Picks the cascades that are refit and rendered this frame. The first one
+// follows the camera every frame, the farther ones take turns so each is
+// updated every mCascadeUpdateInterval frames. The others keep the map and
+// the matrix they were rendered with, which stay in step in the uniform
+// buffer, so receivers still project into them correctly.
+//-----------------------------------------------------------------------------
+static uint32_t scheduleCascadeUpdates()
+{
+	const uint32_t allCascades = (1u << renderData.mCascadeCount) - 1;
+	const unsigned int interval = std::max(1u, renderData.mCascadeUpdateInterval);
+	const unsigned int frame = renderData.mCascadeFrame++;
+	if (renderData.mCascadesInvalid || interval == 1) {
+		renderData.mCascadesInvalid = false;
+		return allCascades;
+	}
+
+	uint32_t cascades = 1u;
+	for (uint32_t cascade = 1; cascade < renderData.mCascadeCount; ++cascade) {
+		if ((cascade - 1) % interval == frame % interval) {
+			cascades |= 1u << cascade;
+		}
+	}
+	return cascades & allCascades;
+}
+
+void Renderer::RenderScene(const RenderSnapshot& snapshot) {
+	renderData.mSnapshot = &snapshot;
+	if (snapshot.mApplyShadowSettings) {
+		SetShadowSettings(snapshot.mShadowSettings);
+	}
+	renderData.mSceneBuffer.Sync(snapshot);
+	renderData.mSceneBuffer.Bind();
+	renderData.mStats = RenderStats();
+	fitCascadesToDepth();
+	renderData.mCascadeUpdateMask = scheduleCascadeUpdates();
+	getLightSpaceMatrices(renderData.mLightSpaceMatrices, renderData.mCascadeUpdateMask);
+	cullObjects();
+	buildRenderQueue();
+	buildDrawCommands();
+	renderData.mLightClusters.Update(snapshot.mCamera, snapshot.mLights);
+	renderData.mStats.mLights = renderData.mLightClusters.GetLightCount();
+	renderData.mStats.mLightClusterEntries = renderData.mLightClusters.GetIndexCount();
+	buildFrameGraph();
+	renderData.mFrameGraph.Run();
+	renderData.mSnapshot = nullptr;
+
+	const GLStateStats stateStats = gGLState.TakeStats();
+	renderData.mStats.mStateChanges = stateStats.mIssued;
+	renderData.mStats.mRedundantStateChanges = stateStats.mSuppressed;
+}
+
+//-----------------------------------------------------------------------------
+// Declares this frame's passes. The shadow maps are imported since cascades
+// keep their maps across frames, the scene targets are transient and come
+// from the graph's pool. Hi-Z and the depth reduction only feed later frames
+// and the present leaves the graph, so those three are the side effects
+// everything else is kept alive by.
+//-----------------------------------------------------------------------------
+void Renderer::buildFrameGraph()
+{
+	FrameGraph& graph = renderData.mFrameGraph;
+	graph.Reset();
+	const Camera& camera = renderData.mSnapshot->mCamera;
+
+	const unsigned int resolution = renderData.mDepthMapResolution;
+	const FrameGraphTexture shadowMaps = graph.Import("ShadowMaps", renderData.mLightDepthMaps,
+		{ resolution, resolution, renderData.mCascadeCount, shadowInternalFormat(renderData.mShadowDepthFormat) });
+	FrameGraphBuilder shadows = graph.AddPass("Shadows", [](const FrameGraph&) { shadowPass(); });
+	shadows.Write(shadowMaps);
+
+	FrameGraphTexture shadowMoments = INVALID_FRAME_GRAPH_TEXTURE;
+	if (renderData.mShadowTechnique == SHADOW_TECHNIQUE_EVSM) {
+		const uint32_t updated = renderData.mCascadeUpdateMask;
+		const FrameGraphTextureDesc momentDesc = { resolution, resolution, renderData.mCascadeCount,
+			GLenum(renderData.mShadowDepthFormat != SHADOW_DEPTH_16 ? GL_RGBA32F : GL_RGBA16F) };
+		shadowMoments = graph.Import("ShadowMoments", renderData.mShadowMoments.GetTexture(), momentDesc);
+		if (updated != 0) {
+			// Only the cascades rendered this frame are rebuilt, the others keep last frame's moments.
+			// Each step reads the previous one's image stores, the graph issues the barriers in between
+			// The scratch is created by the pass that uses it, the handle outlives this function until Run()
+			static FrameGraphTexture momentScratch = INVALID_FRAME_GRAPH_TEXTURE;
+			FrameGraphBuilder blurX = graph.AddPass("ShadowMomentsBlurX", [shadowMaps, updated](const FrameGraph& resources) {
+				renderData.mShadowMoments.BlurX(resources.GetTexture(shadowMaps), resources.GetTexture(momentScratch), updated);
+			});
+			momentScratch = blurX.Create("ShadowMomentScratch", momentDesc);
+			blurX.Read(shadowMaps);
+			blurX.WriteImage(momentScratch);
+
+			FrameGraphBuilder blurY = graph.AddPass("ShadowMomentsBlurY", [updated](const FrameGraph& resources) {
+				renderData.mShadowMoments.BlurY(resources.GetTexture(momentScratch), updated);
+			});
+			blurY.Read(momentScratch);
+			blurY.WriteImage(shadowMoments);
+
+			FrameGraphBuilder mips = graph.AddPass("ShadowMomentsMips", [updated](const FrameGraph&) { renderData.mShadowMoments.GenerateMips(updated); });
+			mips.Read(shadowMoments);
+			mips.WriteImage(shadowMoments);
+		}
+	}
+
+	FrameGraphBuilder lighting = graph.AddPass("Lighting", [](const FrameGraph&) { lightingPass(); });
+	const FrameGraphTexture sceneColor = lighting.Create("SceneColor", { renderData.mScreenWidth, renderData.mScreenHeight, 0, GL_RGBA8 });
+	const FrameGraphTexture sceneDepth = lighting.Create("SceneDepth", { renderData.mScreenWidth, renderData.mScreenHeight, 0, GL_DEPTH_COMPONENT32F });
+	lighting.WriteColor(sceneColor);
+	lighting.WriteDepth(sceneDepth);
+	lighting.Read(shadowMaps);
+	if (shadowMoments != INVALID_FRAME_GRAPH_TEXTURE) {
+		lighting.Read(shadowMoments);
+	}
+
+	// Keep this frame's depth for next frame's occlusion culling and cascade fit
+	if (renderData.mGpuCulling) {
+		const glm::mat4 viewProjection = camera.GetProjection() * camera.GetView();
+		FrameGraphBuilder hiZ = graph.AddPass("HiZ", [sceneDepth, viewProjection](const FrameGraph& resources) {
+			renderData.mCulling.BuildHiZ(resources.GetTexture(sceneDepth), viewProjection);
+		});
+		hiZ.Read(sceneDepth);
+		hiZ.SideEffect();
+	}
+	if (renderData.mSampleDistribution) {
+		const float nearPlane = camera.GetNearPlane();
+		const float farPlane = camera.GetFarPlane();
+		FrameGraphBuilder reduction = graph.AddPass("DepthReduction", [sceneDepth, nearPlane, farPlane](const FrameGraph& resources) {
+			renderData.mDepthReduction.Reduce(resources.GetTexture(sceneDepth), renderData.mScreenWidth, renderData.mScreenHeight, nearPlane, farPlane);
+		});
+		reduction.Read(sceneDepth);
+		reduction.SideEffect();
+	}
+
+	FrameGraphBuilder present = graph.AddPass("Present", [sceneColor](const FrameGraph& resources) {
+		gGLState.BindFramebuffer(GL_READ_FRAMEBUFFER, resources.GetFramebuffer(sceneColor, INVALID_FRAME_GRAPH_TEXTURE));
+		gGLState.BindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		glBlitFramebuffer(0, 0, renderData.mScreenWidth, renderData.mScreenHeight, 0, 0, renderData.mScreenWidth, renderData.mScreenHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		gGLState.BindFramebuffer(GL_FRAMEBUFFER, 0);
+	});
+	present.Read(sceneColor);
+	present.SideEffect();
 }
 
-void Renderer::RenderScene() {
-	shadowPass();
-	lightingPass();
+static void updateObjectBounds(uint32_t index)
+{
+	const RenderSnapshot& snapshot = *renderData.mSnapshot;
+	const GpuMesh* mesh = gResources.mGpuMeshes.TryGet(snapshot.mObjects[index].mMesh);
+	if (!mesh) {
+		renderData.mFrustumCuller.SetBounds(index, glm::vec3(0.0f), glm::vec3(0.0f));
+		return;
+	}
+
+	glm::vec3 center, extents;
+	TransformBounds(snapshot.mWorldMatrices[index], mesh->boundsMin, mesh->boundsMax, center, extents);
+	renderData.mFrustumCuller.SetBounds(index, center, extents);
+}
+
+static bool isCachedCaster(const RenderObject& object)
+{
+	return renderData.mStaticShadowCache && object.mType == ObjectType::OBJECT_TYPE_STATIC;
+}
+
+//-----------------------------------------------------------------------------
+// Works out which layers of the static shadow cache no longer match this
+// frame's cascades. A layer is rendered again when its light matrix changed
+// (the cascade moved with the camera), and all of them when the light turned
+// or a static object was added or moved.
+//-----------------------------------------------------------------------------
+static uint32_t findDirtyStaticCascades(bool staticChanged)
+{
+	if (!renderData.mStaticShadowCache) {
+		return 0;
+	}
+	const CascadeMatrices& lightMatrices = renderData.mLightSpaceMatrices;
+	const uint32_t cascadeCount = renderData.mCascadeCount;
+	const uint32_t allCascades = (1u << cascadeCount) - 1;
+
+	uint32_t dirty = 0;
+	if (staticChanged || renderData.mStaticLightDirection != renderData.mLightDirection ||
+		!renderData.mStaticCacheValid) {
+		dirty = allCascades;
+	}
+	else {
+		for (uint32_t cascade = 0; cascade < cascadeCount; ++cascade) {
+			if (renderData.mStaticCascadeMatrices[cascade] != lightMatrices[cascade]) {
+				dirty |= 1u << cascade;
+			}
+		}
+	}
+
+	renderData.mStaticCascadeMatrices = lightMatrices;
+	renderData.mStaticCacheValid = true;
+	renderData.mStaticLightDirection = renderData.mLightDirection;
+	return dirty;
+}
+
+//-----------------------------------------------------------------------------
+// Keeps the world space boxes in step with the transforms (only the ones that
+// moved are recomputed), fills mVisibleObjects for the lighting pass and a
+// visible list plus per object mask for each shadow cascade.
+//-----------------------------------------------------------------------------
+void Renderer::cullObjects()
+{
+	const RenderSnapshot& snapshot = *renderData.mSnapshot;
+	FrustumCuller& culler = renderData.mFrustumCuller;
+	const uint32_t objectCount = static_cast<uint32_t>(snapshot.mObjects.size());
+
+	bool staticChanged = false;
+	if (culler.Size() != objectCount) {
+		culler.Resize(objectCount);
+		for (uint32_t i = 0; i < objectCount; ++i) {
+			updateObjectBounds(i);
+		}
+		staticChanged = true;
+	}
+	else {
+		for (uint32_t object : snapshot.mChangedObjects) {
+			updateObjectBounds(object);
+			staticChanged |= isCachedCaster(snapshot.mObjects[object]);
+		}
+	}
+
+	renderData.mVisibleObjects.clear();
+	culler.Cull(snapshot.mCamera.GetFrustumPlanes(), renderData.mVisibleObjects);
+	renderData.mStats.mVisibleObjects = static_cast<unsigned int>(renderData.mVisibleObjects.size());
+
+	const CascadeMatrices& lightMatrices = renderData.mLightSpaceMatrices;
+	const uint32_t cascadeCount = renderData.mCascadeCount;
+	const uint32_t updated = renderData.mCascadeUpdateMask;
+	renderData.mCascadeObjects.resize(cascadeCount);
+	renderData.mCascadeMasks.assign(objectCount, 0);
+
+	// Every cascade fills its own list, so they are culled side by side
+	gJobSystem.ParallelFor(cascadeCount, 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t cascade = begin; cascade < end; ++cascade) {
+			renderData.mCascadeObjects[cascade].clear();
+			if ((updated & (1u << cascade)) == 0) {
+				continue;
+			}
+
+			// Extrude the ortho volume towards the light by dropping its near plane, casters
+			// between the light and the cascade still throw shadows into it (depth is clamped)
+			FrustumPlanes planes = ExtractFrustumPlanes(lightMatrices[cascade]);
+			planes[4] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+			culler.Cull(planes, renderData.mCascadeObjects[cascade]);
+		}
+	});
+
+	for (uint32_t cascade = 0; cascade < cascadeCount; ++cascade) {
+		if ((updated & (1u << cascade)) == 0) {
+			continue;
+		}
+		renderData.mStats.mCascadesUpdated++;
+
+		const std::vector<uint32_t>& casters = renderData.mCascadeObjects[cascade];
+		for (uint32_t object : casters) {
+			renderData.mCascadeMasks[object] |= 1u << cascade;
+		}
+		renderData.mStats.mShadowCasters += static_cast<unsigned int>(casters.size());
+	}
+
+	// Static casters only draw into the cached layers that are out of date, the ones whose
+	// cascade sits this frame out wait for its turn
+	const uint32_t outOfDate = findDirtyStaticCascades(staticChanged) | renderData.mStaticPendingCascades;
+	const uint32_t dirty = outOfDate & updated;
+	renderData.mStaticPendingCascades = outOfDate & ~updated;
+	renderData.mStaticDirtyCascades = dirty;
+	renderData.mStaticCascadeMasks.assign(objectCount, 0);
+	if (dirty != 0) {
+		for (uint32_t i = 0; i < objectCount; ++i) {
+			if (isCachedCaster(snapshot.mObjects[i])) {
+				renderData.mStaticCascadeMasks[i] = renderData.mCascadeMasks[i] & dirty;
+			}
+		}
+	}
+	for (uint32_t cascade = 0; cascade < cascadeCount; ++cascade) {
+		renderData.mStats.mStaticCascadeRebuilds += (dirty >> cascade) & 1u;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Records the draw packets for every pass, RECORD_BATCH_SIZE objects per job
+// into a command buffer of the job's own. Each job sorts what it recorded and
+// the queue merges the buffers by key afterwards.
+//-----------------------------------------------------------------------------
+void Renderer::buildRenderQueue()
+{
+	constexpr uint32_t RECORD_BATCH_SIZE = 1024;
+	RenderQueue& queue = renderData.mRenderQueue;
+	const RenderSnapshot& snapshot = *renderData.mSnapshot;
+	const uint32_t objectCount = static_cast<uint32_t>(snapshot.mObjects.size());
+	queue.Reset((objectCount + RECORD_BATCH_SIZE - 1) / RECORD_BATCH_SIZE);
+
+	const unsigned int depthProgram = gResources.mShaderPrograms.at(renderData.mVertexLayer ? "depthLayered" : "depth").mIndex;
+	const unsigned int shadowProgram = gResources.mShaderPrograms.at("shadow").mIndex;
+	const unsigned int prepassProgram = gResources.mShaderPrograms.at("prepass").mIndex;
+	const glm::vec3 cameraPosition = snapshot.mCamera.GetPosition();
+	const float farPlane = snapshot.mCamera.GetFarPlane();
+
+	gJobSystem.ParallelFor(objectCount, RECORD_BATCH_SIZE, [&](uint32_t begin, uint32_t end) {
+		CommandBuffer& commands = queue.GetCommandBuffer(begin / RECORD_BATCH_SIZE);
+
+		// The visible list is ascending, so it is walked alongside the objects
+		const std::vector<uint32_t>& visible = renderData.mVisibleObjects;
+		size_t nextVisible = std::lower_bound(visible.begin(), visible.end(), begin) - visible.begin();
+
+		for (uint32_t i = begin; i < end; ++i) {
+			const bool inView = nextVisible < visible.size() && visible[nextVisible] == i;
+			if (inView) {
+				nextVisible++;
+			}
+
+			const RenderObject& object = snapshot.mObjects[i];
+			const MeshHandle mesh = object.mMesh;
+			if (!gResources.mGpuMeshes.IsAlive(mesh)) {
+				continue;
+			}
+
+			// Texture field 0 means "no texture", so arrays start at 1. Objects whose textures
+			// share an array share the key, the layer is picked per instance in the shader
+			const GpuTexture* texture = gResources.mGpuTextures.TryGet(object.mTexture);
+			const uint32_t textureKey = texture && texture->mArray != UINT32_MAX ? texture->mArray + 1 : 0;
+			const float depth = glm::length(glm::vec3(snapshot.mWorldMatrices[i][3]) - cameraPosition) / farPlane;
+
+			// The depth program never samples the diffuse texture, so it does not split shadow batches
+			if (isCachedCaster(object)) {
+				if (renderData.mStaticCascadeMasks[i] != 0) {
+					commands.Push(RenderKey::Make(RenderPass::RENDER_PASS_SHADOW_STATIC, depthProgram, 0, mesh.mIndex, depth), i);
+				}
+			}
+			else if (renderData.mCascadeMasks[i] != 0) {
+				commands.Push(RenderKey::Make(RenderPass::RENDER_PASS_SHADOW, depthProgram, 0, mesh.mIndex, depth), i);
+			}
+			if (!inView) {
+				continue;
+			}
+			// Opted in types are drawn twice, depth only front to back and then shaded where they won
+			if (renderData.mDepthPrepassTypes & ObjectTypeBit(object.mType)) {
+				commands.Push(RenderKey::Make(RenderPass::RENDER_PASS_DEPTH_PREPASS, prepassProgram, 0, mesh.mIndex, depth), i);
+				commands.Push(RenderKey::Make(RenderPass::RENDER_PASS_LIGHTING_EQUAL, shadowProgram, textureKey, mesh.mIndex, depth), i);
+			}
+			else {
+				commands.Push(RenderKey::Make(RenderPass::RENDER_PASS_LIGHTING, shadowProgram, textureKey, mesh.mIndex, depth), i);
+			}
+		}
+		commands.Sort();
+	});
+
+	queue.Merge();
+
+	size_t first = 0;
+	size_t last = 0;
+	queue.GetPassRange(RenderPass::RENDER_PASS_DEPTH_PREPASS, first, last);
+	renderData.mStats.mPrepassObjects = static_cast<unsigned int>(last - first);
+}
+
+//-----------------------------------------------------------------------------
+// Flattens the sorted queue into instanced commands for all passes at once.
+// Items with equal keys above the depth field draw the same mesh with the same
+// state, so each such group becomes one command per submesh with one instance
+// per object. A new batch starts whenever the pass, program or bound texture
+// array would change.
+//-----------------------------------------------------------------------------
+void Renderer::buildDrawCommands()
+{
+	std::vector<DrawElementsIndirectCommand>& commands = renderData.mDrawCommands;
+	std::vector<uint32_t>& instances = renderData.mInstances;
+	std::vector<InstanceInfo>& infos = renderData.mInstanceInfos;
+	std::vector<DrawBatch>& batches = renderData.mDrawBatches;
+	commands.clear();
+	instances.clear();
+	infos.clear();
+	batches.clear();
+
+	const std::vector<RenderItem>& items = renderData.mRenderQueue.GetItems();
+	uint64_t batchKey = UINT64_MAX;
+
+	size_t groupStart = 0;
+	while (groupStart < items.size()) {
+		const uint64_t groupKey = items[groupStart].mKey >> RenderKey::MESH_SHIFT;
+		size_t groupEnd = groupStart + 1;
+		while (groupEnd < items.size() && (items[groupEnd].mKey >> RenderKey::MESH_SHIFT) == groupKey) {
+			groupEnd++;
+		}
+		const RenderObject& object = renderData.mSnapshot->mObjects[items[groupStart].mObject];
+
+		// Everything above the mesh field decides which state the batch needs
+		const uint64_t key = items[groupStart].mKey >> RenderKey::TEXTURE_SHIFT;
+		if (key != batchKey) {
+			const uint32_t textureKey = RenderKey::Texture(items[groupStart].mKey);
+			DrawBatch batch;
+			batch.mPass = RenderKey::Pass(items[groupStart].mKey);
+			batch.mProgram = RenderKey::Program(items[groupStart].mKey);
+			batch.mTextureArray = textureKey != 0 ? textureKey - 1 : UINT32_MAX;
+			batch.mFirstCommand = static_cast<uint32_t>(commands.size());
+			batch.mCommandCount = 0;
+			batch.mFirstInstance = static_cast<uint32_t>(instances.size());
+			batch.mInstanceCount = 0;
+			batches.push_back(batch);
+			batchKey = key;
+		}
+
+		// Layered shadows draw an object once per cascade it overlaps, the vertex shader picks the layer
+		const RenderPass pass = batches.back().mPass;
+		const bool layered = renderData.mVertexLayer && (pass == RenderPass::RENDER_PASS_SHADOW || pass == RenderPass::RENDER_PASS_SHADOW_STATIC);
+		const std::vector<uint32_t>& masks = pass == RenderPass::RENDER_PASS_SHADOW_STATIC ? renderData.mStaticCascadeMasks : renderData.mCascadeMasks;
+
+		// Submeshes get their own instance range so GPU culling can drop them separately
+		const GpuMesh& mesh = gResources.mGpuMeshes.Get(object.mMesh);
+		for (unsigned int i = 0; i < mesh.recordCount; ++i) {
+			const DrawRecord& record = gResources.mDrawRecords[mesh.firstRecord + i];
+			const uint32_t commandIndex = static_cast<uint32_t>(commands.size());
+			const uint32_t firstInstance = static_cast<uint32_t>(instances.size());
+
+			for (size_t item = groupStart; item < groupEnd; ++item) {
+				const uint32_t objectIndex = items[item].mObject;
+				if (layered) {
+					const uint32_t mask = masks[objectIndex];
+					for (uint32_t cascade = 0; cascade < renderData.mCascadeCount; ++cascade) {
+						if (mask & (1u << cascade)) {
+							instances.push_back(objectIndex | (cascade << INSTANCE_CASCADE_SHIFT));
+						}
+					}
+				}
+				else {
+					instances.push_back(objectIndex);
+				}
+			}
+			if (renderData.mGpuCulling) {
+				infos.resize(instances.size(), { commandIndex, mesh.firstRecord + i });
+			}
+
+			DrawElementsIndirectCommand command;
+			command.mCount = record.indexCount;
+			command.mInstanceCount = static_cast<uint32_t>(instances.size()) - firstInstance;
+			command.mFirstIndex = record.firstIndex;
+			command.mBaseVertex = record.baseVertex;
+			command.mBaseInstance = firstInstance;
+			commands.push_back(command);
+			batches.back().mInstanceCount += command.mInstanceCount;
+		}
+		batches.back().mCommandCount += mesh.recordCount;
+
+		groupStart = groupEnd;
+	}
+
+	// Orphan and refill, the previous frame's data may still be in flight
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, renderData.mIndirectBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, renderData.mInstanceBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, instances.size() * sizeof(uint32_t), instances.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	if (renderData.mGpuCulling) {
+		renderData.mCulling.Upload(renderData.mIndirectBuffer, renderData.mInstanceBuffer, infos, commands.size());
+	}
 }
 
 void Renderer::shadowPass()
@@ -73,54 +879,101 @@ void Renderer::shadowPass()
 	//-----------------------------------------------------------------------------
 	// 0. Uniform buffer setup
 	//-----------------------------------------------------------------------------
-	const auto lightMatrices = getLightSpaceMatrices();
+	const int cascadeCount = int(renderData.mCascadeCount);
 	glBindBuffer(GL_UNIFORM_BUFFER, renderData.mMatricesUniformBuffer);
-	for (size_t i = 0; i < lightMatrices.size(); ++i)
-	{
-		glBufferSubData(GL_UNIFORM_BUFFER, i * sizeof(glm::mat4x4), sizeof(glm::mat4x4), &lightMatrices[i]);
-	}
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, cascadeCount * sizeof(glm::mat4x4), renderData.mLightSpaceMatrices.data());
 	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	ShaderProgram& program = gResources.mShaderPrograms.at(renderData.mVertexLayer ? "depthLayered" : "depth");
+	gGLState.UseProgram(program.mId);
+	gGLState.Viewport(0, 0, renderData.mDepthMapResolution, renderData.mDepthMapResolution);
+	gGLState.CullFace(GL_FRONT);  // peter panning
+	gGLState.Enable(GL_DEPTH_CLAMP); // keeps casters in front of the near plane, see cullObjects
 	//-----------------------------------------------------------------------------
-	// 1. Render depth of scene to texture (from light's perspective)
+	// 1. Bring the static cache up to date and start from a copy of it
 	//-----------------------------------------------------------------------------
-	ShaderProgram& program = gResources.mShaderPrograms.at("depth");
-	glUseProgram(program.mId);
-
-	glBindFramebuffer(GL_FRAMEBUFFER, renderData.mLightFrameBuffer);
-	glViewport(0, 0, renderData.mDepthMapResolution, renderData.mDepthMapResolution);
-	glClear(GL_DEPTH_BUFFER_BIT);
-	glCullFace(GL_FRONT);  // peter panning
-	for (auto& object : gScene.objects) {
-		glm::vec3 position = object->GetPosition();
-		glm::vec3 rotation = object->GetRotation();
-		glm::vec3 scale = object->GetScale();
-
-		glm::mat4 model = glm::translate(glm::mat4(1.0f), position) *
-			glm::rotate(glm::mat4(1.0f), glm::radians(rotation.x), glm::vec3(1, 0, 0)) *
-			glm::rotate(glm::mat4(1.0f), glm::radians(rotation.y), glm::vec3(0, 1, 0)) *
-			glm::rotate(glm::mat4(1.0f), glm::radians(rotation.z), glm::vec3(0, 0, 1)) *
-			glm::scale(glm::mat4(1.0f), scale);
-
-		program.SetUniform("model", model);
-
-		// Bind texture
-		Texture texture = gResources.mTextures.at(object->GetTexture());
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, texture.mId);
-
-		// Bind mesh
-		Mesh mesh = gResources.mMeshes.at(object->GetMesh());
-		glBindVertexArray(mesh.vao);
-		glDrawElements(GL_TRIANGLES, mesh.indices.size(), GL_UNSIGNED_INT, 0);
-		glBindVertexArray(0);
-	}
-	glCullFace(GL_BACK);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	// Masks are read by the depth geometry shader to only emit into the layers an object overlaps,
+	// layered instances already exist only for those
+	const GLsizei layers = GLsizei(cascadeCount);
+	if (renderData.mStaticShadowCache) {
+		const uint32_t dirty = renderData.mStaticDirtyCascades;
+		if (dirty != 0) {
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, renderData.mStaticCascadeMaskBuffer);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, renderData.mStaticCascadeMasks.size() * sizeof(uint32_t), renderData.mStaticCascadeMasks.data(), GL_STREAM_DRAW);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+			gGLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_CASCADE_MASKS, renderData.mStaticCascadeMaskBuffer);
+
+			if (renderData.mGpuCulling) {
+				renderData.mCulling.CullCascades(GetPassRange(RenderPass::RENDER_PASS_SHADOW_STATIC), cascadeCount, renderData.mVertexLayer);
+			}
+
+			constexpr float farDepth = 1.0f;
+			for (GLsizei layer = 0; layer < layers; ++layer) {
+				if (dirty & (1u << layer)) {
+					glClearTexSubImage(renderData.mStaticDepthMaps, 0, 0, 0, layer, renderData.mDepthMapResolution, renderData.mDepthMapResolution, 1,
+						GL_DEPTH_COMPONENT, GL_FLOAT, &farDepth);
+				}
+			}
+			gGLState.BindFramebuffer(GL_FRAMEBUFFER, renderData.mStaticFrameBuffer);
+			submitPass(RenderPass::RENDER_PASS_SHADOW_STATIC, false);
+		}
+
+		// Cascades that are not updated keep last time's static and dynamic casters
+		for (GLsizei layer = 0; layer < layers; ++layer) {
+			if (renderData.mCascadeUpdateMask & (1u << layer)) {
+				glCopyImageSubData(renderData.mStaticDepthMaps, GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer,
+					renderData.mLightDepthMaps, GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer,
+					renderData.mDepthMapResolution, renderData.mDepthMapResolution, 1);
+			}
+		}
+		gGLState.BindFramebuffer(GL_FRAMEBUFFER, renderData.mLightFrameBuffer);
+	}
+	else {
+		constexpr float farDepth = 1.0f;
+		for (GLsizei layer = 0; layer < layers; ++layer) {
+			if (renderData.mCascadeUpdateMask & (1u << layer)) {
+				glClearTexSubImage(renderData.mLightDepthMaps, 0, 0, 0, layer, renderData.mDepthMapResolution, renderData.mDepthMapResolution, 1,
+					GL_DEPTH_COMPONENT, GL_FLOAT, &farDepth);
+			}
+		}
+		gGLState.BindFramebuffer(GL_FRAMEBUFFER, renderData.mLightFrameBuffer);
+	}
 	//-----------------------------------------------------------------------------
-	// Reset viewport
+	// 2. Render depth of the remaining casters on top (from light's perspective)
 	//-----------------------------------------------------------------------------
-	glViewport(0, 0, 1280, 720);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, renderData.mCascadeMaskBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, renderData.mCascadeMasks.size() * sizeof(uint32_t), renderData.mCascadeMasks.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	gGLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_CASCADE_MASKS, renderData.mCascadeMaskBuffer);
+
+	if (renderData.mGpuCulling) {
+		renderData.mCulling.CullCascades(GetPassRange(RenderPass::RENDER_PASS_SHADOW), cascadeCount, renderData.mVertexLayer);
+	}
+	submitPass(RenderPass::RENDER_PASS_SHADOW, false);
+	gGLState.Disable(GL_DEPTH_CLAMP);
+	gGLState.CullFace(GL_BACK);
+}
+
+//-----------------------------------------------------------------------------
+// Lays down depth for the object types in mDepthPrepassTypes, so their lighting
+// only runs the full shader (cascade selection, PCF) once per pixel. Runs inside
+// the lighting pass, with the scene targets the frame graph bound and cleared.
+//-----------------------------------------------------------------------------
+void Renderer::depthPrepass()
+{
+	if (renderData.mStats.mPrepassObjects == 0) {
+		return;
+	}
+
+	ShaderProgram& program = gResources.mShaderPrograms.at("prepass");
+	const Camera& camera = renderData.mSnapshot->mCamera;
+	gGLState.UseProgram(program.mId);
+	program.Set(renderData.mDepthPrepassUniforms.mProjection, camera.GetProjection());
+	program.Set(renderData.mDepthPrepassUniforms.mView, camera.GetView());
+
+	gGLState.ColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	submitPass(RenderPass::RENDER_PASS_DEPTH_PREPASS, false);
+	gGLState.ColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 }
 
 //void LightPass() {
@@ -142,148 +995,147 @@ void Renderer::lightingPass()
 	//-----------------------------------------------------------------------------
 	// 2. Render scene as normal using the generated depth/shadow map  
 	//-----------------------------------------------------------------------------
-	glViewport(0, 0, 1280, 720);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	const Camera& camera = renderData.mSnapshot->mCamera;
+	const glm::mat4 viewProjection = camera.GetProjection() * camera.GetView();
+	if (renderData.mGpuCulling) {
+		renderData.mCulling.CullCamera(GetPassRange(RenderPass::RENDER_PASS_DEPTH_PREPASS, RenderPass::RENDER_PASS_LIGHTING_EQUAL), viewProjection);
+	}
+
+	// The frame graph bound the scene targets, cleared, with their viewport
+	depthPrepass();
+
 	ShaderProgram& program = gResources.mShaderPrograms.at("shadow");
-	glUseProgram(program.mId);
-	program.SetUniform("projection", gScene.camera.get()->GetProjection()); // camera proj matrix
-	program.SetUniform("view", gScene.camera.get()->GetView()); // camera view matrix
+	gGLState.UseProgram(program.mId);
+	const LightingUniforms& uniforms = renderData.mLightingUniforms;
+	program.Set(uniforms.mProjection, camera.GetProjection()); // camera proj matrix
+	program.Set(uniforms.mView, camera.GetView()); // camera view matrix
 	//-----------------------------------------------------------------------------
 	// Set light uniforms
 	//-----------------------------------------------------------------------------
-	program.SetUniform("viewPos", gScene.camera.get()->GetPosition()); 
-	program.SetUniform("lightDir", renderData.mLightDirection);
-	program.SetUniformFloat("farPlane", gScene.camera.get()->GetFarPlane());
-	program.SetUniformInt("cascadeCount", renderData.mShadowCascadeLevels.size());
-	for (size_t i = 0; i < renderData.mShadowCascadeLevels.size(); ++i)
-	{
-		program.SetUniformFloat("cascadePlaneDistances[" + std::to_string(i) + "]", renderData.mShadowCascadeLevels[i]);
-	}
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D_ARRAY, renderData.mLightDepthMaps);
-	
-	for (auto& object : gScene.objects) {
-		glm::vec3 position = object->GetPosition();
-		glm::vec3 rotation = object->GetRotation();
-		glm::vec3 scale = object->GetScale();
-
-		glm::mat4 model = glm::translate(glm::mat4(1.0f), position) *
-			glm::rotate(glm::mat4(1.0f), glm::radians(rotation.x), glm::vec3(1, 0, 0)) *
-			glm::rotate(glm::mat4(1.0f), glm::radians(rotation.y), glm::vec3(0, 1, 0)) *
-			glm::rotate(glm::mat4(1.0f), glm::radians(rotation.z), glm::vec3(0, 0, 1)) *
-			glm::scale(glm::mat4(1.0f), scale);
-
-		program.SetUniform("model", model);
-
-		// Bind texture
-		Texture texture = gResources.mTextures.at(object->GetTexture());
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, texture.mId);
-
-		// Bind mesh
-		Mesh mesh = gResources.mMeshes.at(object->GetMesh());
-		glBindVertexArray(mesh.vao);
-		glDrawElements(GL_TRIANGLES, mesh.indices.size(), GL_UNSIGNED_INT, 0);
-		glBindVertexArray(0);
-	}
-}
+	program.Set(uniforms.mViewPos, camera.GetPosition());
+	program.Set(uniforms.mLightDir, renderData.mLightDirection);
+	// All 16 are compared in the shader, the unused ones can never be passed
+	float cascadePlaneDistances[GpuCulling::MAX_CASCADES];
+	std::fill(std::begin(cascadePlaneDistances), std::end(cascadePlaneDistances), FLT_MAX);
+	std::copy(renderData.mShadowCascadeLevels.begin(), renderData.mShadowCascadeLevels.end(), cascadePlaneDistances);
+	program.Set(uniforms.mCascadePlaneDistances, cascadePlaneDistances, GLsizei(GpuCulling::MAX_CASCADES));
+	// Light lists were bound to their storage buffer bindings by LightClusters::Update
+	program.Set(uniforms.mClusterScale, renderData.mLightClusters.GetScale(renderData.mScreenWidth, renderData.mScreenHeight));
+	program.Set(uniforms.mClusterBias, renderData.mLightClusters.GetBias());
+	gGLState.BindTexture(1, GL_TEXTURE_2D_ARRAY, renderData.mLightDepthMaps);
+	gGLState.BindTexture(2, GL_TEXTURE_2D_ARRAY, renderData.mShadowMoments.GetTexture());
 
-std::vector<glm::vec4> getFrustumCornersWorldSpace(const glm::mat4& projview)
-{
-	const auto inv = glm::inverse(projview);
+	// Counts fragment shader invocations, read back a few frames later so it never stalls
+	const unsigned int queryFrame = renderData.mOverdrawFrame % RendererData::OVERDRAW_QUERY_FRAMES;
+	glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS, renderData.mOverdrawQueries[queryFrame]);
 
-	std::vector<glm::vec4> frustumCorners;
-	for (unsigned int x = 0; x < 2; ++x)
-	{
-		for (unsigned int y = 0; y < 2; ++y)
-		{
-			for (unsigned int z = 0; z < 2; ++z)
-			{
-				const glm::vec4 pt = inv * glm::vec4(2.0f * x - 1.0f, 2.0f * y - 1.0f, 2.0f * z - 1.0f, 1.0f);
-				frustumCorners.push_back(pt / pt.w);
-			}
+	// Depth is already final for prepassed objects, only the surface that won gets shaded
+	gGLState.DepthFunc(GL_EQUAL);
+	gGLState.DepthMask(GL_FALSE);
+	submitPass(RenderPass::RENDER_PASS_LIGHTING_EQUAL, true);
+	gGLState.DepthMask(GL_TRUE);
+	gGLState.DepthFunc(GL_LESS);
+	submitPass(RenderPass::RENDER_PASS_LIGHTING, true);
+
+	glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS);
+	renderData.mOverdrawFrame++;
+	if (renderData.mOverdrawFrame >= RendererData::OVERDRAW_QUERY_FRAMES) {
+		const unsigned int oldest = renderData.mOverdrawQueries[renderData.mOverdrawFrame % RendererData::OVERDRAW_QUERY_FRAMES];
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(oldest, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available) {
+			GLuint64 fragments = 0;
+			glGetQueryObjectui64v(oldest, GL_QUERY_RESULT, &fragments);
+			renderData.mShadedFragments = fragments;
 		}
 	}
-
-	return frustumCorners;
+	// Frames whose query is not back yet report the last count that was
+	renderData.mStats.mShadedFragments = renderData.mShadedFragments;
 }
 
-std::vector<glm::vec4> getFrustumCornersWorldSpace(const glm::mat4& proj, const glm::mat4& view)
+//-----------------------------------------------------------------------------
+// Corners of the camera frustum between two view distances, straight from the
+// camera basis and field of view. Near plane first, each plane ordered
+// (-x, -y), (+x, -y), (-x, +y), (+x, +y).
+//-----------------------------------------------------------------------------
+void getFrustumCornersWorldSpace(const float nearPlane, const float farPlane, FrustumCorners& corners)
 {
-	return getFrustumCornersWorldSpace(proj * view);
+	const Camera& camera = renderData.mSnapshot->mCamera;
+	const glm::vec3 position = camera.GetPosition();
+	const glm::vec3 forward = camera.GetForward();
+	const glm::vec3 right = glm::normalize(glm::cross(forward, camera.GetUp()));
+	const glm::vec3 up = glm::cross(right, forward);
+	const float tanHalfFov = std::tan(glm::radians(camera.GetFOV()) * 0.5f);
+
+	const float distances[2] = { nearPlane, farPlane };
+	for (int plane = 0; plane < 2; ++plane)
+	{
+		const glm::vec3 center = position + forward * distances[plane];
+		const glm::vec3 halfUp = up * (distances[plane] * tanHalfFov);
+		const glm::vec3 halfRight = right * (distances[plane] * tanHalfFov * camera.GetAspectRatio());
+		corners[plane * 4 + 0] = center - halfRight - halfUp;
+		corners[plane * 4 + 1] = center + halfRight - halfUp;
+		corners[plane * 4 + 2] = center - halfRight + halfUp;
+		corners[plane * 4 + 3] = center + halfRight + halfUp;
+	}
 }
 
+//-----------------------------------------------------------------------------
+// Fits the cascade to a bounding sphere of its frustum slice instead of a box,
+// so its size no longer changes as the camera turns, then snaps it to whole
+// shadow map texels in a light space that does not move with the camera.
+// Together that keeps shadow edges from shimmering and makes the matrix only
+// change when the slice moves by at least a texel.
+//-----------------------------------------------------------------------------
 glm::mat4 getLightSpaceMatrix(const float nearPlane, const float farPlane)
 {
-	const auto projection = glm::perspective(glm::radians(70.0f), (float)1280 / (float)720, nearPlane, farPlane);
-	const auto corners = getFrustumCornersWorldSpace(projection, gScene.camera.get()->GetView());
+	const Camera& camera = renderData.mSnapshot->mCamera;
+	FrustumCorners corners;
+	getFrustumCornersWorldSpace(nearPlane, farPlane, corners);
 
-	glm::vec3 center = glm::vec3(0, 0, 0);
-	for (const auto& v : corners)
+	// The slice is symmetric around the view axis, the center that balances the near and far
+	// corners is along it. k is the corner offset per unit of view distance
+	const float tanHalfFov = std::tan(glm::radians(camera.GetFOV()) * 0.5f);
+	const float k2 = tanHalfFov * tanHalfFov * (1.0f + camera.GetAspectRatio() * camera.GetAspectRatio());
+	const float centerDistance = std::min(0.5f * (nearPlane + farPlane) * (1.0f + k2), farPlane);
+	const glm::vec3 center = camera.GetPosition() + camera.GetForward() * centerDistance;
+
+	float radius = 0.0f;
+	for (const glm::vec3& corner : corners)
 	{
-		center += glm::vec3(v);
+		radius = std::max(radius, glm::length(corner - center));
 	}
-	center /= corners.size();
+	// Rounded up so float noise from turning the camera can not change the size
+	radius = std::ceil(radius * 16.0f) / 16.0f;
 
-	const auto lightView = glm::lookAt(center + renderData.mLightDirection, center, glm::vec3(0.0f, 1.0f, 0.0f));
+	const glm::vec3 lightUp = std::abs(renderData.mLightDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	const glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), -renderData.mLightDirection, lightUp);
 
-	float minX = std::numeric_limits<float>::max();
-	float maxX = std::numeric_limits<float>::lowest();
-	float minY = std::numeric_limits<float>::max();
-	float maxY = std::numeric_limits<float>::lowest();
-	float minZ = std::numeric_limits<float>::max();
-	float maxZ = std::numeric_limits<float>::lowest();
-	for (const auto& v : corners)
-	{
-		const auto trf = lightView * v;
-		minX = std::min(minX, trf.x);
-		maxX = std::max(maxX, trf.x);
-		minY = std::min(minY, trf.y);
-		maxY = std::max(maxY, trf.y);
-		minZ = std::min(minZ, trf.z);
-		maxZ = std::max(maxZ, trf.z);
-	}
-
-	// Tune this parameter according to the scene
-	constexpr float zMult = 10.0f;
-	if (minZ < 0)
-	{
-		minZ *= zMult;
-	}
-	else
-	{
-		minZ /= zMult;
-	}
-	if (maxZ < 0)
-	{
-		maxZ /= zMult;
-	}
-	else
-	{
-		maxZ *= zMult;
-	}
+	const float texelSize = 2.0f * radius / float(renderData.mDepthMapResolution);
+	const glm::vec3 lightCenter = glm::floor(glm::vec3(lightView * glm::vec4(center, 1.0f)) / texelSize) * texelSize;
 
-	const glm::mat4 lightProjection = glm::ortho(minX, maxX, minY, maxY, minZ, maxZ);
+	// Depth only spans the sphere, casters between it and the light are held at the near
+	// plane by depth clamping. That makes the depth range 2 * radius like the width, so the
+	// shader can bias in texels for every cascade
+	const glm::mat4 lightProjection = glm::ortho(
+		lightCenter.x - radius, lightCenter.x + radius,
+		lightCenter.y - radius, lightCenter.y + radius,
+		-lightCenter.z - radius, -lightCenter.z + radius);
 	return lightProjection * lightView;
 }
 
-std::vector<glm::mat4> getLightSpaceMatrices()
+void getLightSpaceMatrices(CascadeMatrices& matrices, uint32_t cascades)
 {
-	std::vector<glm::mat4> ret;
-	for (size_t i = 0; i < renderData.mShadowCascadeLevels.size() + 1; ++i)
+	// Cascade i covers [levels[i - 1], levels[i]], with the fitted depth range at both ends
+	const std::vector<float>& levels = renderData.mShadowCascadeLevels;
+	for (size_t i = 0; i < levels.size() + 1; ++i)
 	{
-		if (i == 0)
-		{
-			ret.push_back(getLightSpaceMatrix(gScene.camera.get()->GetNearPlane(), renderData.mShadowCascadeLevels[i]));
-		}
-		else if (i < renderData.mShadowCascadeLevels.size())
-		{
-			ret.push_back(getLightSpaceMatrix(renderData.mShadowCascadeLevels[i - 1], renderData.mShadowCascadeLevels[i]));
-		}
-		else
+		if ((cascades & (1u << i)) == 0)
 		{
-			ret.push_back(getLightSpaceMatrix(renderData.mShadowCascadeLevels[i - 1], gScene.camera.get()->GetFarPlane()));
+			continue;
 		}
+		const float nearPlane = i == 0 ? renderData.mShadowNear : levels[i - 1];
+		const float farPlane = i < levels.size() ? levels[i] : renderData.mShadowFar;
+		matrices[i] = getLightSpaceMatrix(nearPlane, farPlane);
 	}
-	return ret;
 }
\ No newline at end of file
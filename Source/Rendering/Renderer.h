@@ -19,9 +19,22 @@ Step 5: Apply the shader associated with the object
 #ifndef RENDERER_H
 #define RENDERER_H
 
+#include <array>
 #include <vector>
 
 #include "Core/Math.h"
+#include "Rendering/Culling.h"
+#include "Rendering/DepthReduction.h"
+#include "Rendering/FrameGraph.h"
+#include "Rendering/GpuCulling.h"
+#include "Rendering/LightClusters.h"
+#include "Rendering/RenderQueue.h"
+#include "Rendering/SceneBuffer.h"
+#include "Rendering/ShadowMoments.h"
+#include "Rendering/Shader.h"
+#include "Rendering/Texture.h"
+
+struct RenderSnapshot;
 
 enum Resolution {
 	LOW = 512,
@@ -31,29 +44,200 @@ enum Resolution {
 	EXTREME = 8192
 };
 
+enum ShadowDepthFormat {
+	SHADOW_DEPTH_32F,
+	SHADOW_DEPTH_24,
+	SHADOW_DEPTH_16
+};
+
+// Kernel shadowMapping.frag filters with, every tap is a hardware compare with bilinear PCF
+enum ShadowFilter {
+	SHADOW_FILTER_SINGLE,	// One tap
+	SHADOW_FILTER_GATHER,	// 3x3 tent from four textureGather calls
+	SHADOW_FILTER_POISSON	// 12 taps on a disc rotated per pixel
+};
+
+enum ShadowTechnique {
+	SHADOW_TECHNIQUE_PCF,	// Compare sampler with the ShadowFilter kernel
+	SHADOW_TECHNIQUE_EVSM	// Prefiltered exponential variance moments, ShadowFilter is unused
+};
+
+enum ShadowQuality {
+	SHADOW_QUALITY_LOW,
+	SHADOW_QUALITY_MEDIUM,
+	SHADOW_QUALITY_HIGH,
+	SHADOW_QUALITY_ULTRA,
+	SHADOW_QUALITY_COUNT
+};
+
+// What the shadow map arrays are allocated with, change through Renderer::SetShadowSettings
+struct ShadowSettings {
+	unsigned int mResolution = Resolution::HIGH;
+	unsigned int mCascadeCount = 5;
+	ShadowDepthFormat mDepthFormat = SHADOW_DEPTH_32F;
+	ShadowFilter mFilter = SHADOW_FILTER_POISSON;
+	ShadowTechnique mTechnique = SHADOW_TECHNIQUE_PCF;	// EVSM moments are RGBA16F with 16 bit depth, RGBA32F otherwise
+};
+
+ShadowSettings GetShadowQualitySettings(ShadowQuality quality);
+const char* GetShadowDepthFormatName(ShadowDepthFormat format);
+
+// GPU memory held by the shadow map arrays
+struct ShadowMemoryStats {
+	uint64_t mShadowMapBytes = 0;	// mLightDepthMaps
+	uint64_t mStaticCacheBytes = 0;	// mStaticDepthMaps
+	uint64_t mMomentBytes = 0;	// mShadowMoments, 0 unless EVSM is on
+
+	uint64_t GetTotalBytes() const { return mShadowMapBytes + mStaticCacheBytes + mMomentBytes; }
+};
+
+// Resolved once in Renderer::Init so the frame loop never looks a uniform up by name
+struct LightingUniforms {
+	UniformHandle<glm::mat4> mProjection;
+	UniformHandle<glm::mat4> mView;
+	UniformHandle<glm::vec3> mViewPos;
+	UniformHandle<glm::vec3> mLightDir;
+	UniformHandle<float> mCascadePlaneDistances;
+	UniformHandle<glm::vec3> mClusterScale;
+	UniformHandle<float> mClusterBias;
+};
+
+struct DepthPrepassUniforms {
+	UniformHandle<glm::mat4> mProjection;
+	UniformHandle<glm::mat4> mView;
+};
+
+using CascadeMatrices = std::array<glm::mat4, GpuCulling::MAX_CASCADES>;
+using FrustumCorners = std::array<glm::vec3, 8>;
+
+// Layout fixed by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+	unsigned int mCount;
+	unsigned int mInstanceCount;
+	unsigned int mFirstIndex;
+	int mBaseVertex;
+	unsigned int mBaseInstance;	// First slot in the instance buffer
+};
+
+// A run of indirect commands that share program and texture array, issued as one multi draw
+struct DrawBatch {
+	RenderPass mPass;
+	uint32_t mProgram;
+	uint32_t mTextureArray;	// Index into gResources.mTextureArrays, UINT32_MAX for none
+	uint32_t mFirstCommand;
+	uint32_t mCommandCount;
+	uint32_t mFirstInstance;
+	uint32_t mInstanceCount;
+};
+
+struct RenderStats {
+	unsigned int mDrawCalls = 0;	// glDraw* calls issued
+	unsigned int mDrawCommands = 0;	// Submesh instances submitted
+	unsigned int mVisibleObjects = 0;	// Objects inside the camera frustum (CPU culling)
+	unsigned int mShadowCasters = 0;	// Object/cascade pairs the depth pass rasterizes
+	unsigned int mStaticCascadeRebuilds = 0;	// Cached static cascades that had to be rendered again
+	unsigned int mCascadesUpdated = 0;	// Cascades refit and rendered, the rest kept last frame's map and matrix
+	unsigned int mPrepassObjects = 0;	// Objects in view that went through the depth prepass
+	uint64_t mShadedFragments = 0;	// Lighting pass fragment shader invocations, a few frames old
+	unsigned int mLights = 0;	// Local lights binned into clusters
+	unsigned int mLightClusterEntries = 0;	// Light indices over all clusters
+	unsigned int mStateChanges = 0;	// Binds and state sets that reached GL, through gGLState
+	unsigned int mRedundantStateChanges = 0;	// The ones gGLState dropped because nothing would have changed
+};
+
 // TODO: Make lightdir to the scene (and any other/future data)
 struct RendererData {
 	const glm::vec3 mLightDirection = glm::normalize(glm::vec3(20.0f, 50, 20.0f));
-	const unsigned int mDepthMapResolution = Resolution::HIGH;
+	const unsigned int mScreenWidth = 1280;
+	const unsigned int mScreenHeight = 720;
+	unsigned int mDepthMapResolution = Resolution::HIGH;	// These three change through Renderer::SetShadowSettings
+	unsigned int mCascadeCount = 5;	// Shadow map layers
+	ShadowDepthFormat mShadowDepthFormat = SHADOW_DEPTH_32F;
+	ShadowFilter mShadowFilter = SHADOW_FILTER_POISSON;
+	ShadowTechnique mShadowTechnique = SHADOW_TECHNIQUE_PCF;
+	ShadowMoments mShadowMoments;	// Built from mLightDepthMaps after the shadow pass with EVSM
+	bool mVertexLayer = true;	// Layered instancing instead of the cascade geometry shader, cleared in Init when unsupported
 	unsigned int mLightFrameBuffer;
-	unsigned int mLightDepthMaps;
+	unsigned int mLightDepthMaps = 0;
 	unsigned int mMatricesUniformBuffer;
-	std::vector<float> mShadowCascadeLevels;
+	FrameGraph mFrameGraph;	// Rebuilt every frame, owns the scene color and depth targets
+	std::vector<float> mShadowCascadeLevels;	// mCascadeCount - 1 split distances
+	bool mSampleDistribution = true;	// Fit the cascades to the depth range the camera saw (SDSM)
+	DepthReduction mDepthReduction;
+	LightClusters mLightClusters;	// Point and spot lights from gScene.lights, the sun above is the only shadowed one
+	float mShadowNear = 0.0f;	// View depth range the cascades cover, the camera planes until a reduction comes back
+	float mShadowFar = 0.0f;
+	RenderQueue mRenderQueue;
+	FrustumCuller mFrustumCuller;	// Indexed like gScene.objects
+	std::vector<uint32_t> mVisibleObjects;
+	CascadeMatrices mLightSpaceMatrices;	// What each cascade was last rendered with, mCascadeCount used
+	unsigned int mCascadeUpdateInterval = 4;	// Cascades past the first update every this many frames, round-robin. 1 updates all every frame
+	uint32_t mCascadeUpdateMask = 0;	// Cascades refit and rendered this frame
+	bool mCascadesInvalid = true;	// Render every cascade next frame, their splits or maps changed
+	unsigned int mCascadeFrame = 0;
+	std::vector<std::vector<uint32_t>> mCascadeObjects;	// Visible list per cascade
+	std::vector<uint32_t> mCascadeMasks;	// Per object, bit n set when it casts into cascade n
+	unsigned int mCascadeMaskBuffer;
+	bool mStaticShadowCache = true;	// Keep OBJECT_TYPE_STATIC casters in a depth array of their own
+	unsigned int mStaticFrameBuffer;
+	unsigned int mStaticDepthMaps = 0;	// Copied into mLightDepthMaps each frame before dynamic casters draw
+	CascadeMatrices mStaticCascadeMatrices;	// What each cached layer was rendered with
+	bool mStaticCacheValid = false;
+	glm::vec3 mStaticLightDirection = glm::vec3(0.0f);
+	uint32_t mStaticDirtyCascades = 0;	// Cached layers rendered again this frame
+	uint32_t mStaticPendingCascades = 0;	// Out of date cached layers waiting for their cascade's turn
+	std::vector<uint32_t> mStaticCascadeMasks;	// mCascadeMasks of static objects, limited to the dirty layers
+	unsigned int mStaticCascadeMaskBuffer;
+	SceneBuffer mSceneBuffer;
+	bool mMultiDrawIndirect = true;	// Off falls back to one instanced draw per command, for comparison
+	unsigned int mIndirectBuffer;
+	unsigned int mInstanceBuffer;
+	std::vector<DrawElementsIndirectCommand> mDrawCommands;	// One per (mesh, texture array) group and submesh
+	std::vector<uint32_t> mInstances;	// Object indices, a range per command
+	std::vector<DrawBatch> mDrawBatches;
+	bool mGpuCulling = true;	// Needs mMultiDrawIndirect
+	GpuCulling mCulling;
+	std::vector<InstanceInfo> mInstanceInfos;
+	uint32_t mDepthPrepassTypes = 0;	// ObjectTypeBit mask, those types lay depth down first and shade with GL_EQUAL
+	static constexpr unsigned int OVERDRAW_QUERY_FRAMES = 3;
+	unsigned int mOverdrawQueries[OVERDRAW_QUERY_FRAMES];
+	unsigned int mOverdrawFrame = 0;
+	uint64_t mShadedFragments = 0;	// Last query result that came back, RenderStats is reset every frame
+	RenderStats mStats;
+	LightingUniforms mLightingUniforms;
+	DepthPrepassUniforms mDepthPrepassUniforms;
+	const RenderSnapshot* mSnapshot = nullptr;	// Frame being rendered, only set inside RenderScene
 };
 
 class Renderer {
 public:
+	// Runs before the render thread starts, on the thread that created the context
 	static void Init();
-	static void RenderScene();
+	// Render thread only, the snapshot has to stay untouched until it returns
+	static void RenderScene(const RenderSnapshot& snapshot);
+	// Reallocates the shadow maps when anything changed, call between frames
+	static void SetShadowSettings(const ShadowSettings& settings);
+	static void SetCascadeCount(unsigned int count);
+	static ShadowSettings GetShadowSettings();
+	static ShadowMemoryStats GetShadowMemoryStats();
+
+	// Commands and instances of the passes [first, last] in the current frame's draw buffers
+	static CullRange GetPassRange(RenderPass first, RenderPass last);
+	static CullRange GetPassRange(RenderPass pass) { return GetPassRange(pass, pass); }
 private:
+	static void cullObjects();
+	static void buildRenderQueue();
+	static void buildDrawCommands();
+	static void buildFrameGraph();
 	static void shadowPass();
+	static void depthPrepass();
 	static void lightingPass();
 };
 
-std::vector<glm::vec4> getFrustumCornersWorldSpace(const glm::mat4& projview);
-std::vector<glm::vec4> getFrustumCornersWorldSpace(const glm::mat4& proj, const glm::mat4& view);
+void getFrustumCornersWorldSpace(const float nearPlane, const float farPlane, FrustumCorners& corners);
 glm::mat4 getLightSpaceMatrix(const float nearPlane, const float farPlane);
-std::vector<glm::mat4> getLightSpaceMatrices();
+// Only refits the cascades whose bit is set in cascades, the others are left as they are
+void getLightSpaceMatrices(CascadeMatrices& matrices, uint32_t cascades = UINT32_MAX);
 
 extern RendererData renderData;
 
@@ -0,0 +1,167 @@
+#include "SceneBuffer.h"
+
+#include <algorithm>
+
+#include "Log/Logger.h"
+#include "Core/Resources.h"
+#include "Rendering/Bindings.h"
+#include "Rendering/GLState.h"
+#include "Rendering/RenderSnapshot.h"
+
+static constexpr uint32_t SCATTER_GROUP_SIZE = 64;
+
+void SceneBuffer::Init()
+{
+	mScatterProgram = &gResources.mShaderPrograms.at("sceneScatter");
+	mUpdateCountUniform = mScatterProgram->GetUniform<int>("updateCount");
+
+	// Region size is kept a multiple of 64 updates, which keeps region offsets aligned for glBindBufferRange
+	resizeObjects(1024);
+	resizeStaging(1024);
+}
+
+void SceneBuffer::Sync(const RenderSnapshot& snapshot)
+{
+	const uint32_t objectCount = static_cast<uint32_t>(snapshot.mObjects.size());
+	const uint32_t previousCount = mObjectCount;
+	mPending.clear();
+
+	if (objectCount > mObjectCapacity) {
+		// The new buffer starts out empty, so everything has to go up again
+		uint32_t capacity = mObjectCapacity;
+		while (capacity < objectCount) {
+			capacity *= 2;
+		}
+		resizeObjects(capacity);
+		for (uint32_t i = 0; i < objectCount; i++) {
+			mPending.push_back(i);
+		}
+	}
+	else {
+		for (uint32_t i = previousCount; i < objectCount; i++) {
+			mPending.push_back(i);
+		}
+	}
+
+	mObjectCount = objectCount;
+
+	// New objects are already queued above, only pick up moved ones that were there before
+	const bool fullUpload = mPending.size() == objectCount;
+	if (!fullUpload) {
+		for (uint32_t object : snapshot.mChangedObjects) {
+			if (object < previousCount) {
+				mPending.push_back(object);
+			}
+		}
+	}
+
+	mLastUploadCount = static_cast<uint32_t>(mPending.size());
+	if (!mPending.empty()) {
+		upload(snapshot);
+	}
+}
+
+void SceneBuffer::Bind() const
+{
+	gGLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_OBJECTS, mObjectBuffer);
+}
+
+void SceneBuffer::upload(const RenderSnapshot& snapshot)
+{
+	const uint32_t count = static_cast<uint32_t>(mPending.size());
+	if (count > mStagingCapacity) {
+		uint32_t capacity = mStagingCapacity;
+		while (capacity < count) {
+			capacity *= 2;
+		}
+		resizeStaging(capacity);
+	}
+
+	waitForRegion(mRegion);
+
+	ObjectUpdate* updates = mStagingData + size_t(mRegion) * mStagingCapacity;
+	for (uint32_t i = 0; i < count; i++) {
+		const glm::mat4& model = snapshot.mWorldMatrices[mPending[i]];
+		const TextureHandle texture = snapshot.mObjects[mPending[i]].mTexture;
+
+		ObjectUpdate& update = updates[i];
+		update.mIndex = mPending[i];
+		update.mData.mModel = model;
+		update.mData.mNormalMatrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(model))));
+		update.mData.mMaterial = gResources.mGpuTextures.IsAlive(texture) ? texture.mIndex : UINT32_MAX;
+	}
+
+	//-----------------------------------------------------------------------------
+	// Scatter the staged updates into the object buffer
+	//-----------------------------------------------------------------------------
+	const GLintptr offset = GLintptr(mRegion) * mStagingCapacity * sizeof(ObjectUpdate);
+	gGLState.BindBufferRange(GL_SHADER_STORAGE_BUFFER, BINDING_OBJECT_UPDATES, mStagingBuffer, offset, GLsizeiptr(count) * sizeof(ObjectUpdate));
+	gGLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_OBJECTS, mObjectBuffer);
+
+	gGLState.UseProgram(mScatterProgram->mId);
+	mScatterProgram->Set(mUpdateCountUniform, int(count));
+	glDispatchCompute((count + SCATTER_GROUP_SIZE - 1) / SCATTER_GROUP_SIZE, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	mFences[mRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	mRegion = (mRegion + 1) % FRAMES_IN_FLIGHT;
+}
+
+void SceneBuffer::waitForRegion(uint32_t region)
+{
+	if (!mFences[region]) {
+		return;
+	}
+
+	GLenum result = glClientWaitSync(mFences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	while (result == GL_TIMEOUT_EXPIRED) {
+		result = glClientWaitSync(mFences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+	}
+	glDeleteSync(mFences[region]);
+	mFences[region] = nullptr;
+}
+
+void SceneBuffer::resizeObjects(uint32_t capacity)
+{
+	if (mObjectBuffer) {
+		glDeleteBuffers(1, &mObjectBuffer);
+		gGLState.ForgetBuffer(mObjectBuffer);
+	}
+
+	glGenBuffers(1, &mObjectBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mObjectBuffer);
+	glBufferStorage(GL_SHADER_STORAGE_BUFFER, GLsizeiptr(capacity) * sizeof(ObjectData), nullptr, 0);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	mObjectCapacity = capacity;
+}
+
+void SceneBuffer::resizeStaging(uint32_t capacity)
+{
+	for (uint32_t region = 0; region < FRAMES_IN_FLIGHT; region++) {
+		waitForRegion(region);
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mStagingBuffer);
+	if (mStagingBuffer) {
+		glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+		glDeleteBuffers(1, &mStagingBuffer);
+		gGLState.ForgetBuffer(mStagingBuffer);
+	}
+
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	const GLsizeiptr size = GLsizeiptr(capacity) * FRAMES_IN_FLIGHT * sizeof(ObjectUpdate);
+
+	glGenBuffers(1, &mStagingBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mStagingBuffer);
+	glBufferStorage(GL_SHADER_STORAGE_BUFFER, size, nullptr, flags);
+	mStagingData = static_cast<ObjectUpdate*>(glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, size, flags));
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	if (!mStagingData) {
+		spdlog::error("SCENEBUFFER::RESIZESTAGING: Failed to map {} bytes", size);
+	}
+
+	mStagingCapacity = capacity;
+	mRegion = 0;
+}
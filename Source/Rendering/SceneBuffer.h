@@ -0,0 +1,68 @@
+#ifndef SCENE_BUFFER_H
+#define SCENE_BUFFER_H
+
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "Core/Math.h"
+#include "Rendering/Shader.h"
+
+struct RenderSnapshot;
+
+// Matches ObjectData in the shaders (std430)
+struct ObjectData {
+	glm::mat4 mModel;
+	glm::mat4 mNormalMatrix;	// transpose(inverse(mat3(model))), padded to a mat4
+	uint32_t mMaterial;
+	uint32_t mPadding[3];
+};
+
+// Matches ObjectUpdate in sceneScatter.comp
+struct ObjectUpdate {
+	uint32_t mIndex;
+	uint32_t mPadding[3];
+	ObjectData mData;
+};
+
+//---------------------------------------------------------------------------------
+// GPU resident copy of per object render state, indexed by object index
+// (gl_BaseInstance in the shaders). Only objects whose transform changed are
+// written each frame: they go into a persistently mapped staging ring and a
+// compute pass scatters them into the object buffer, so upload bandwidth
+// follows the number of changes instead of the number of objects.
+//---------------------------------------------------------------------------------
+class SceneBuffer {
+public:
+	static constexpr uint32_t FRAMES_IN_FLIGHT = 3;
+
+	void Init();
+	void Sync(const RenderSnapshot& snapshot);
+	void Bind() const;
+
+	uint32_t GetLastUploadCount() const { return mLastUploadCount; }
+private:
+	void resizeObjects(uint32_t capacity);
+	void resizeStaging(uint32_t capacity);
+	void waitForRegion(uint32_t region);
+	void upload(const RenderSnapshot& snapshot);
+
+	GLuint mObjectBuffer = 0;
+	uint32_t mObjectCapacity = 0;
+	uint32_t mObjectCount = 0;
+
+	GLuint mStagingBuffer = 0;
+	ObjectUpdate* mStagingData = nullptr;
+	uint32_t mStagingCapacity = 0;		// Updates per region
+	uint32_t mRegion = 0;
+	GLsync mFences[FRAMES_IN_FLIGHT] = {};
+
+	ShaderProgram* mScatterProgram = nullptr;
+	UniformHandle<int> mUpdateCountUniform;
+
+	std::vector<uint32_t> mPending;
+	uint32_t mLastUploadCount = 0;
+};
+
+#endif
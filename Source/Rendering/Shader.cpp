@@ -2,9 +2,11 @@
 
 #include <sstream>
 #include <fstream>
+#include <algorithm>
 
 #include "Log/Logger.h"
 #include "Core/Resources.h"
+#include "Rendering/GLState.h"
 
 void ShaderProgram::AddShader(GLenum type, const std::string filepath)
 {
@@ -33,6 +35,19 @@ Shader ShaderProgram::Compile(GLenum type, const std::string filepath)
 		spdlog::error("SHADER::COMPILESHADER: Failed to read shader files");
 	}
 
+	// Defines go after the #version line, #line keeps error messages pointing at the file
+	if (!mDefines.empty())
+	{
+		const size_t versionEnd = shaderSource.find('\n');
+		std::string defines;
+		for (const auto& define : mDefines)
+		{
+			defines += "#define " + define.first + " " + define.second + "\n";
+		}
+		defines += "#line 2\n";
+		shaderSource.insert(versionEnd == std::string::npos ? shaderSource.size() : versionEnd + 1, defines);
+	}
+
 	// Create shader and compile it
 	result.mId = glCreateShader(type);
 	const GLchar* source = shaderSource.c_str();
@@ -57,6 +72,7 @@ Shader ShaderProgram::Compile(GLenum type, const std::string filepath)
 
 void ShaderProgram::Link()
 {
+	const GLuint previousId = mId;
 	mId = glCreateProgram();
 
 	for (auto& shader : mShaders)
@@ -79,6 +95,213 @@ void ShaderProgram::Link()
 		glDetachShader(mId, shader.mId);
 		glDeleteShader(shader.mId);
 	}
+
+	if (previousId != 0)
+	{
+		glDeleteProgram(previousId);
+		gGLState.ForgetProgram(previousId);
+	}
+
+	reflect();
+}
+
+//-----------------------------------------------------------------------------
+// Rebuilds the uniform/uniform block tables from the linked program and
+// re-resolves every slot handed out through GetUniform, so existing handles
+// keep working after a reload.
+//-----------------------------------------------------------------------------
+void ShaderProgram::reflect()
+{
+	mUniforms.clear();
+
+	GLint uniformCount = 0;
+	GLint maxNameLength = 0;
+	glGetProgramiv(mId, GL_ACTIVE_UNIFORMS, &uniformCount);
+	glGetProgramiv(mId, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+	std::vector<GLchar> nameBuffer(std::max(maxNameLength, 1));
+	for (GLint i = 0; i < uniformCount; i++)
+	{
+		UniformInfo info;
+		GLsizei nameLength = 0;
+		glGetActiveUniform(mId, static_cast<GLuint>(i), maxNameLength, &nameLength, &info.mSize, &info.mType, nameBuffer.data());
+		info.mName.assign(nameBuffer.data(), nameLength);
+
+		// Members of uniform blocks have no location, they are set through the block's buffer
+		info.mLocation = glGetUniformLocation(mId, info.mName.c_str());
+		if (info.mLocation < 0)
+		{
+			continue;
+		}
+
+		const size_t arraySuffix = info.mName.rfind("[0]");
+		if (arraySuffix != std::string::npos && arraySuffix + 3 == info.mName.size())
+		{
+			info.mName.erase(arraySuffix);
+		}
+		mUniforms.push_back(info);
+	}
+	std::sort(mUniforms.begin(), mUniforms.end(), [](const UniformInfo& a, const UniformInfo& b) { return a.mName < b.mName; });
+
+	std::vector<UniformBlockInfo> previousBlocks;
+	previousBlocks.swap(mUniformBlocks);
+
+	GLint blockCount = 0;
+	GLint maxBlockNameLength = 0;
+	glGetProgramiv(mId, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+	glGetProgramiv(mId, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxBlockNameLength);
+
+	nameBuffer.resize(std::max(maxBlockNameLength, 1));
+	for (GLint i = 0; i < blockCount; i++)
+	{
+		UniformBlockInfo info;
+		GLsizei nameLength = 0;
+		info.mIndex = static_cast<GLuint>(i);
+		glGetActiveUniformBlockName(mId, info.mIndex, maxBlockNameLength, &nameLength, nameBuffer.data());
+		info.mName.assign(nameBuffer.data(), nameLength);
+		glGetActiveUniformBlockiv(mId, info.mIndex, GL_UNIFORM_BLOCK_DATA_SIZE, &info.mDataSize);
+
+		// Relinking resets block bindings, carry over whatever was bound before
+		info.mBinding = 0;
+		for (const UniformBlockInfo& previous : previousBlocks)
+		{
+			if (previous.mName == info.mName)
+			{
+				info.mBinding = previous.mBinding;
+				glUniformBlockBinding(mId, info.mIndex, info.mBinding);
+				break;
+			}
+		}
+		mUniformBlocks.push_back(info);
+	}
+
+	for (size_t slot = 0; slot < mSlotNames.size(); slot++)
+	{
+		mSlotLocations[slot] = uniformLocation(mSlotNames[slot]);
+	}
+}
+
+const UniformInfo* ShaderProgram::FindUniform(const std::string& name) const
+{
+	auto it = std::lower_bound(mUniforms.begin(), mUniforms.end(), name,
+		[](const UniformInfo& info, const std::string& value) { return info.mName < value; });
+	if (it != mUniforms.end() && it->mName == name)
+	{
+		return &*it;
+	}
+	return nullptr;
+}
+
+const UniformBlockInfo* ShaderProgram::FindUniformBlock(const std::string& name) const
+{
+	for (const UniformBlockInfo& block : mUniformBlocks)
+	{
+		if (block.mName == name)
+		{
+			return &block;
+		}
+	}
+	return nullptr;
+}
+
+void ShaderProgram::BindUniformBlock(const std::string& name, GLuint binding)
+{
+	for (UniformBlockInfo& block : mUniformBlocks)
+	{
+		if (block.mName == name)
+		{
+			block.mBinding = binding;
+			glUniformBlockBinding(mId, block.mIndex, binding);
+			return;
+		}
+	}
+	spdlog::warn("SHADER::BINDUNIFORMBLOCK: No active uniform block named '{}'", name);
+}
+
+GLint ShaderProgram::uniformLocation(const std::string& name) const
+{
+	const UniformInfo* info = FindUniform(name);
+	return info ? info->mLocation : -1;
+}
+
+static bool uniformTypeMatches(GLenum actual, GLenum expected)
+{
+	if (actual == expected)
+	{
+		return true;
+	}
+
+	// Samplers and bools are set through the int setter
+	if (expected == GL_INT)
+	{
+		switch (actual)
+		{
+		case GL_BOOL:
+		case GL_SAMPLER_2D:
+		case GL_SAMPLER_2D_ARRAY:
+		case GL_SAMPLER_2D_SHADOW:
+		case GL_SAMPLER_2D_ARRAY_SHADOW:
+		case GL_SAMPLER_CUBE:
+			return true;
+		}
+	}
+	return false;
+}
+
+int ShaderProgram::findOrAddSlot(const std::string& name, GLenum expectedType)
+{
+	const UniformInfo* info = FindUniform(name);
+	if (!info)
+	{
+		// Not fatal, the compiler may have optimized it out. The slot stays at location -1 until a reload brings it back.
+		spdlog::warn("SHADER::GETUNIFORM: No active uniform named '{}'", name);
+	}
+	else if (!uniformTypeMatches(info->mType, expectedType))
+	{
+		spdlog::warn("SHADER::GETUNIFORM: Uniform '{}' has type {:#x}, handle expects {:#x}", name, info->mType, expectedType);
+	}
+
+	for (size_t slot = 0; slot < mSlotNames.size(); slot++)
+	{
+		if (mSlotNames[slot] == name)
+		{
+			return static_cast<int>(slot);
+		}
+	}
+
+	mSlotNames.push_back(name);
+	mSlotLocations.push_back(info ? info->mLocation : -1);
+	return static_cast<int>(mSlotNames.size() - 1);
+}
+
+GLint ShaderProgram::slotLocation(int slot) const
+{
+	return slot >= 0 && size_t(slot) < mSlotLocations.size() ? mSlotLocations[slot] : -1;
+}
+
+void ShaderProgram::Set(UniformHandle<int> handle, int value)
+{
+	glUniform1i(slotLocation(handle.mSlot), value);
+}
+
+void ShaderProgram::Set(UniformHandle<float> handle, float value)
+{
+	glUniform1f(slotLocation(handle.mSlot), value);
+}
+
+void ShaderProgram::Set(UniformHandle<float> handle, const float* values, GLsizei count)
+{
+	glUniform1fv(slotLocation(handle.mSlot), count, values);
+}
+
+void ShaderProgram::Set(UniformHandle<glm::vec3> handle, const glm::vec3& value)
+{
+	glUniform3fv(slotLocation(handle.mSlot), 1, glm::value_ptr(value));
+}
+
+void ShaderProgram::Set(UniformHandle<glm::mat4> handle, const glm::mat4& value)
+{
+	glUniformMatrix4fv(slotLocation(handle.mSlot), 1, GL_FALSE, glm::value_ptr(value));
 }
 
 bool ShaderProgram::Reload() {
@@ -115,27 +338,51 @@ bool ShaderProgram::Reload() {
 	return false;
 }
 
+void ShaderProgram::SetDefine(const std::string& name, const std::string& value)
+{
+	for (auto& define : mDefines)
+	{
+		if (define.first == name)
+		{
+			define.second = value;
+			return;
+		}
+	}
+	mDefines.emplace_back(name, value);
+}
+
+// Relinks with the current defines. Uniform handles and block bindings carry over
+// (see reflect()), plain uniform values such as sampler units have to be set again
+void ShaderProgram::Rebuild()
+{
+	for (auto& shader : mShaders)
+	{
+		shader.mId = Compile(shader.mType, shader.mFilepath).mId;
+	}
+	Link();
+}
+
 void ShaderProgram::SetUniformInt(const std::string& name, int value)
 {
-	GLint location = glGetUniformLocation(mId, name.c_str());
+	GLint location = uniformLocation(name);
 	glUniform1i(location, value);
 }
 
 void ShaderProgram::SetUniformFloat(const std::string& name, float value)
 {
-	GLint location = glGetUniformLocation(mId, name.c_str());
+	GLint location = uniformLocation(name);
 	glUniform1f(location, value);
 }
 
 void ShaderProgram::SetUniform(const std::string& name, const glm::vec3& value)
 {
-	GLint location = glGetUniformLocation(mId, name.c_str());
+	GLint location = uniformLocation(name);
 	glUniform3fv(location, 1, glm::value_ptr(value));
 }
 
 void ShaderProgram::SetUniform(const std::string& name, const glm::mat4& value)
 {
-	GLint location = glGetUniformLocation(mId, name.c_str());
+	GLint location = uniformLocation(name);
 	glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
 }
 
@@ -150,6 +397,24 @@ void LoadShaderProgram(const std::string name, const std::string vertexShaderPat
 	}
 
 	program.Link();
+	program.mIndex = static_cast<unsigned int>(gResources.mProgramTable.size());
+
+	auto result = gResources.mShaderPrograms.emplace(name, program);
+	if (result.second) {
+		gResources.mProgramTable.push_back(&result.first->second);
+	}
+}
 
-	gResources.mShaderPrograms.emplace(name, program);
+void LoadComputeProgram(const std::string name, const std::string computeShaderPath)
+{
+	ShaderProgram program;
+	program.AddShader(GL_COMPUTE_SHADER, computeShaderPath);
+
+	program.Link();
+	program.mIndex = static_cast<unsigned int>(gResources.mProgramTable.size());
+
+	auto result = gResources.mShaderPrograms.emplace(name, program);
+	if (result.second) {
+		gResources.mProgramTable.push_back(&result.first->second);
+	}
 }
\ No newline at end of file
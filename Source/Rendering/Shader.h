@@ -2,6 +2,7 @@
 #define SHADER_PROGRAM_H
 
 #include <string>
+#include <utility>
 #include <vector>
 #include <filesystem>
 #include <chrono>
@@ -17,21 +18,94 @@ struct Shader {
 	std::filesystem::file_time_type mLastModified;
 };
 
+// Active uniform as reported by the driver after linking
+struct UniformInfo {
+	std::string mName;	// Arrays are stored without the trailing "[0]"
+	GLint mLocation;
+	GLenum mType;
+	GLint mSize;		// Array length, 1 for plain uniforms
+};
+
+struct UniformBlockInfo {
+	std::string mName;
+	GLuint mIndex;
+	GLint mDataSize;
+	GLuint mBinding;
+};
+
+//---------------------------------------------------------------------------------
+// Typed handle to a uniform. It indexes a slot in the program that stores the
+// location, so setting a value is an array read and a glUniform call. Slots are
+// re-resolved by name whenever the program is relinked, so handles survive Reload().
+//---------------------------------------------------------------------------------
+template<typename T>
+struct UniformHandle {
+	int mSlot = -1;
+
+	bool IsValid() const { return mSlot >= 0; }
+};
+
 struct ShaderProgram {
-	GLuint mId;
+	GLuint mId = 0;
+	unsigned int mIndex = 0; // Load order, used as the program field of render sort keys
 	std::vector<Shader> mShaders;
+	std::vector<std::pair<std::string, std::string>> mDefines;	// Injected after #version, for values GLSL needs at compile time
+
+	std::vector<UniformInfo> mUniforms;	// Sorted by name
+	std::vector<UniformBlockInfo> mUniformBlocks;
+	std::vector<std::string> mSlotNames;
+	std::vector<GLint> mSlotLocations;
 
 	void AddShader(GLenum type, const std::string filepath);
 	Shader Compile(GLenum type, const std::string filepath);
 	void Link();
 	bool Reload();
 
+	// Takes effect on the next compile, Rebuild() to apply it right away
+	void SetDefine(const std::string& name, const std::string& value);
+	void Rebuild();
+
+	const UniformInfo* FindUniform(const std::string& name) const;
+	const UniformBlockInfo* FindUniformBlock(const std::string& name) const;
+	void BindUniformBlock(const std::string& name, GLuint binding);
+
+	template<typename T>
+	UniformHandle<T> GetUniform(const std::string& name);
+
+	// The program has to be bound (glUseProgram) for these
+	void Set(UniformHandle<int> handle, int value);
+	void Set(UniformHandle<float> handle, float value);
+	void Set(UniformHandle<float> handle, const float* values, GLsizei count);
+	void Set(UniformHandle<glm::vec3> handle, const glm::vec3& value);
+	void Set(UniformHandle<glm::mat4> handle, const glm::mat4& value);
+
 	void SetUniformInt(const std::string& name, int value);
 	void SetUniformFloat(const std::string& name, float value);
 	void SetUniform(const std::string& name, const glm::vec3& value);
 	void SetUniform(const std::string& name, const glm::mat4& value);
+private:
+	void reflect();
+	int findOrAddSlot(const std::string& name, GLenum expectedType);
+	GLint uniformLocation(const std::string& name) const;
+	// -1 for invalid handles, which glUniform* silently ignores
+	GLint slotLocation(int slot) const;
 };
 
+template<typename T> struct UniformGLType;
+template<> struct UniformGLType<int> { static constexpr GLenum value = GL_INT; };
+template<> struct UniformGLType<float> { static constexpr GLenum value = GL_FLOAT; };
+template<> struct UniformGLType<glm::vec3> { static constexpr GLenum value = GL_FLOAT_VEC3; };
+template<> struct UniformGLType<glm::mat4> { static constexpr GLenum value = GL_FLOAT_MAT4; };
+
+template<typename T>
+UniformHandle<T> ShaderProgram::GetUniform(const std::string& name)
+{
+	UniformHandle<T> handle;
+	handle.mSlot = findOrAddSlot(name, UniformGLType<T>::value);
+	return handle;
+}
+
 void LoadShaderProgram(const std::string name, const std::string vertexShaderPath, const std::string fragShaderPath, const std::string geomShaderPath = ""); 
+void LoadComputeProgram(const std::string name, const std::string computeShaderPath);
 
 #endif 
\ No newline at end of file
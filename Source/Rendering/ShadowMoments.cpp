@@ -0,0 +1,149 @@
+#include "ShadowMoments.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Log/Logger.h"
+#include "Core/Resources.h"
+#include "Rendering/GLState.h"
+
+static constexpr unsigned int BLUR_GROUP_SIZE = 8;
+
+void ShadowMoments::Resize(unsigned int resolution, unsigned int layers, bool use32F)
+{
+	release();
+	if (layers == 0) {
+		return;
+	}
+
+	//-----------------------------------------------------------------------------
+	// The blur's image format follows the moment format, so it is rebuilt on changes
+	//-----------------------------------------------------------------------------
+	if (!mBlurProgram || use32F != m32F) {
+		mBlurProgram = &gResources.mShaderPrograms.at("evsmBlur");
+		mBlurProgram->SetDefine("SHADOW_MOMENTS_32F", use32F ? "1" : "0");
+		mBlurProgram->Rebuild();
+		mBlurPassUniform = mBlurProgram->GetUniform<int>("blurPass");
+		mFirstLayerUniform = mBlurProgram->GetUniform<int>("firstLayer");
+		gGLState.UseProgram(mBlurProgram->mId);
+		mBlurProgram->SetUniformInt("depthMaps", 0);
+	}
+
+	mResolution = resolution;
+	mLayers = layers;
+	mLevels = 1 + static_cast<int>(std::floor(std::log2(float(resolution))));
+	m32F = use32F;
+	const GLenum format = use32F ? GL_RGBA32F : GL_RGBA16F;
+
+	glGenTextures(1, &mMomentMaps);
+	gGLState.BindTexture(0, GL_TEXTURE_2D_ARRAY, mMomentMaps);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, mLevels, format, resolution, resolution, layers);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	GLfloat maxAnisotropy = 1.0f;
+	glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &maxAnisotropy);
+	glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_ANISOTROPY, std::min(maxAnisotropy, 8.0f));
+	gGLState.BindTexture(0, GL_TEXTURE_2D_ARRAY, 0);
+
+	glGenSamplers(1, &mDepthSampler);
+	glSamplerParameteri(mDepthSampler, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+	glSamplerParameteri(mDepthSampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glSamplerParameteri(mDepthSampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+void ShadowMoments::BlurX(GLuint depthMaps, GLuint scratch, uint32_t layerMask)
+{
+	if (!mMomentMaps) {
+		return;
+	}
+
+	const GLenum format = m32F ? GL_RGBA32F : GL_RGBA16F;
+	gGLState.UseProgram(mBlurProgram->mId);
+	mBlurProgram->Set(mBlurPassUniform, 0);
+	gGLState.BindTexture(0, GL_TEXTURE_2D_ARRAY, depthMaps);
+	glBindSampler(0, mDepthSampler);
+	glBindImageTexture(1, scratch, 0, GL_TRUE, 0, GL_WRITE_ONLY, format);
+	dispatchLayers(layerMask, mResolution);
+	glBindSampler(0, 0);
+}
+
+void ShadowMoments::BlurY(GLuint scratch, uint32_t layerMask)
+{
+	if (!mMomentMaps) {
+		return;
+	}
+
+	const GLenum format = m32F ? GL_RGBA32F : GL_RGBA16F;
+	gGLState.UseProgram(mBlurProgram->mId);
+	mBlurProgram->Set(mBlurPassUniform, 1);
+	glBindImageTexture(0, scratch, 0, GL_TRUE, 0, GL_READ_ONLY, format);
+	glBindImageTexture(1, mMomentMaps, 0, GL_TRUE, 0, GL_WRITE_ONLY, format);
+	dispatchLayers(layerMask, mResolution);
+}
+
+//-----------------------------------------------------------------------------
+// glGenerateMipmap would rebuild every cascade, so each level is box filtered
+// from the one above it for the updated layers only. Every level waits on the
+// previous level's image stores, the graph covers the wait after the last one.
+//-----------------------------------------------------------------------------
+void ShadowMoments::GenerateMips(uint32_t layerMask)
+{
+	if (!mMomentMaps) {
+		return;
+	}
+
+	const GLenum format = m32F ? GL_RGBA32F : GL_RGBA16F;
+	gGLState.UseProgram(mBlurProgram->mId);
+	mBlurProgram->Set(mBlurPassUniform, 2);
+	for (int level = 1; level < mLevels; ++level) {
+		if (level > 1) {
+			glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+		}
+		glBindImageTexture(0, mMomentMaps, level - 1, GL_TRUE, 0, GL_READ_ONLY, format);
+		glBindImageTexture(1, mMomentMaps, level, GL_TRUE, 0, GL_WRITE_ONLY, format);
+		dispatchLayers(layerMask, std::max(mResolution >> level, 1u));
+	}
+}
+
+uint64_t ShadowMoments::GetMemoryBytes() const
+{
+	if (!mMomentMaps) {
+		return 0;
+	}
+
+	// The mip chain adds about a third, the blur scratch is a frame graph transient
+	const uint64_t layerBytes = uint64_t(mResolution) * mResolution * (m32F ? 16 : 8);
+	return layerBytes * 4 / 3 * mLayers;
+}
+
+void ShadowMoments::dispatchLayers(uint32_t layerMask, unsigned int size)
+{
+	const GLuint groups = (size + BLUR_GROUP_SIZE - 1) / BLUR_GROUP_SIZE;
+	unsigned int layer = 0;
+	while (layer < mLayers) {
+		if (!(layerMask & (1u << layer))) {
+			++layer;
+			continue;
+		}
+
+		const unsigned int first = layer;
+		while (layer < mLayers && (layerMask & (1u << layer))) {
+			++layer;
+		}
+		mBlurProgram->Set(mFirstLayerUniform, int(first));
+		glDispatchCompute(groups, groups, layer - first);
+	}
+}
+
+void ShadowMoments::release()
+{
+	glDeleteTextures(1, &mMomentMaps);
+	gGLState.ForgetTexture(mMomentMaps);
+	glDeleteSamplers(1, &mDepthSampler);
+	mMomentMaps = 0;
+	mDepthSampler = 0;
+	mLayers = 0;
+}
\ No newline at end of file
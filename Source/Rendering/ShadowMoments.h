@@ -0,0 +1,54 @@
+#ifndef SHADOW_MOMENTS_H
+#define SHADOW_MOMENTS_H
+
+#include <cstdint>
+
+#include <glad/glad.h>
+
+#include "Rendering/Shader.h"
+
+//---------------------------------------------------------------------------------
+// Exponential variance shadow maps built from the cascade depth array. A compute
+// pass warps each depth into (e^cd, e^2cd, -e^-cd, e^-2cd) moments and blurs them
+// separably per cascade, then the mip chain is rebuilt by a compute downsample,
+// so receivers get a soft shadow out of one trilinear, anisotropic sample. Only
+// the cascades the renderer re-rendered this frame are touched, the rest keep
+// last frame's moments. Rendering the casters is
+// left to the depth pass, which keeps the static cache and culling shared. The
+// three steps are separate frame graph passes, the graph owns the scratch array
+// the horizontal blur writes and puts the memory barriers between the image
+// stores and whatever reads them next.
+//---------------------------------------------------------------------------------
+class ShadowMoments {
+public:
+	// Reallocates the moment arrays, 0 layers frees them
+	void Resize(unsigned int resolution, unsigned int layers, bool use32F);
+
+	// The layer mask has a bit per cascade, as in RendererData::mCascadeUpdateMask
+	// Warps the masked layers of the depth array and blurs them along x into the scratch array (image stores)
+	void BlurX(GLuint depthMaps, GLuint scratch, uint32_t layerMask);
+	// Blurs the masked scratch layers along y into the top level of the moments (image stores)
+	void BlurY(GLuint scratch, uint32_t layerMask);
+	// Downsamples the masked layers level by level (image stores)
+	void GenerateMips(uint32_t layerMask);
+
+	GLuint GetTexture() const { return mMomentMaps; }
+	uint64_t GetMemoryBytes() const;
+private:
+	void release();
+	// One dispatch per run of consecutive masked layers
+	void dispatchLayers(uint32_t layerMask, unsigned int size);
+
+	ShaderProgram* mBlurProgram = nullptr;
+	UniformHandle<int> mBlurPassUniform;
+	UniformHandle<int> mFirstLayerUniform;
+
+	GLuint mMomentMaps = 0;
+	GLuint mDepthSampler = 0;	// Reads the depth array with its compare mode off
+	unsigned int mResolution = 0;
+	unsigned int mLayers = 0;
+	int mLevels = 0;
+	bool m32F = false;
+};
+
+#endif
\ No newline at end of file
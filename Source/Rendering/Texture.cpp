@@ -1,44 +1,143 @@
 #include "Texture.h"
 
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
 #include <glad/glad.h>
 #include <stb_image.h>
 
 #include "Log/Logger.h"
 #include "Core/Resources.h"
+#include "Rendering/Bindings.h"
+#include "Rendering/GLState.h"
+
+// Decoded pixels waiting for BuildTextureArrays, always RGBA8 so arrays only split by size
+struct PendingTexture {
+	std::string mName;
+	TextureHandle mHandle;
+	int mWidth;
+	int mHeight;
+	bool mClamp;
+	unsigned char* mPixels;
+};
+
+static std::vector<PendingTexture> pendingTextures;
+// Every material built so far, indexed by handle slot. Kept so a later BuildTextureArrays
+// only appends the new textures instead of dropping the earlier ones from the buffer
+static std::vector<MaterialData> materials;
 
 void LoadTexture(const std::string& path, const std::string& name)
 {
 	Texture texture;
-	glGenTextures(1, &texture.mId);
+	texture.mId = 0;
+	texture.mFilepath = path;
 
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrComponents, 0);
-	if (data)
-	{
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, texture.mId);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-	}
-	else
+	int width, height, nrComponents;
+	unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrComponents, STBI_rgb_alpha);
+	if (!data)
 	{
 		spdlog::warn("TEXTURE::LOADTEXTURE: Failed to load at path: {}", path);
-		stbi_image_free(data);
 	}
 
 	gResources.mTextures.emplace(name, texture);
+	const TextureHandle handle = gResources.mGpuTextures.Create(GpuTexture{ UINT32_MAX, 0 });
+	gResources.mTextureHandles[name] = handle;
+
+	// Textures with alpha used to clamp, the shader does that now since the wrap mode is per array
+	if (data) {
+		pendingTextures.push_back({ name, handle, width, height, nrComponents == 4, data });
+	}
+}
+
+TextureHandle FindTexture(const std::string& name)
+{
+	auto it = gResources.mTextureHandles.find(name);
+	if (it == gResources.mTextureHandles.end()) {
+		spdlog::warn("TEXTURE::FINDTEXTURE: No texture named '{}'", name);
+		return TextureHandle();
+	}
+	return it->second;
+}
+
+//-----------------------------------------------------------------------------
+// Replaces per draw texture binds: same sized textures become slices of one
+// array, and the shaders find the slice through the material buffer. Batches
+// only need a bind when the array changes, which with a uniform texture size
+// is never. Can be called again after more textures were loaded, those get
+// arrays of their own and the earlier ones keep theirs.
+//-----------------------------------------------------------------------------
+void BuildTextureArrays()
+{
+	std::stable_sort(pendingTextures.begin(), pendingTextures.end(), [](const PendingTexture& a, const PendingTexture& b) {
+		return a.mWidth != b.mWidth ? a.mWidth < b.mWidth : a.mHeight < b.mHeight;
+	});
+
+	size_t first = 0;
+	while (first < pendingTextures.size()) {
+		size_t last = first + 1;
+		while (last < pendingTextures.size() && pendingTextures[last].mWidth == pendingTextures[first].mWidth && pendingTextures[last].mHeight == pendingTextures[first].mHeight) {
+			last++;
+		}
+
+		TextureArray array;
+		array.mWidth = pendingTextures[first].mWidth;
+		array.mHeight = pendingTextures[first].mHeight;
+		array.mLayers = static_cast<int>(last - first);
+		const int levels = 1 + static_cast<int>(std::floor(std::log2(std::max(array.mWidth, array.mHeight))));
+
+		glGenTextures(1, &array.mId);
+		gGLState.BindTexture(0, GL_TEXTURE_2D_ARRAY, array.mId);
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, GL_RGBA8, array.mWidth, array.mHeight, array.mLayers);
+
+		const uint32_t arrayIndex = static_cast<uint32_t>(gResources.mTextureArrays.size());
+		for (size_t i = first; i < last; ++i) {
+			PendingTexture& pending = pendingTextures[i];
+			const uint32_t layer = static_cast<uint32_t>(i - first);
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, array.mWidth, array.mHeight, 1, GL_RGBA, GL_UNSIGNED_BYTE, pending.mPixels);
+			stbi_image_free(pending.mPixels);
+
+			GpuTexture& gpuTexture = gResources.mGpuTextures.Get(pending.mHandle);
+			gpuTexture.mArray = arrayIndex;
+			gpuTexture.mLayer = layer;
+			gResources.mTextures.at(pending.mName).mId = array.mId;
+		}
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		gResources.mTextureArrays.push_back(array);
+		first = last;
+	}
+	gGLState.BindTexture(0, GL_TEXTURE_2D_ARRAY, 0);
+
+	// Indexed by handle slot, which is what ObjectData::mMaterial stores
+	if (materials.size() < gResources.mGpuTextures.Capacity()) {
+		materials.resize(gResources.mGpuTextures.Capacity(), MaterialData{ UINT32_MAX, 0, 0, 0 });
+	}
+	for (const PendingTexture& pending : pendingTextures) {
+		const GpuTexture& gpuTexture = gResources.mGpuTextures.Get(pending.mHandle);
+		MaterialData& material = materials[pending.mHandle.mIndex];
+		material.mArray = gpuTexture.mArray;
+		material.mLayer = gpuTexture.mLayer;
+		material.mFlags = pending.mClamp ? MATERIAL_CLAMP : 0;
+	}
+	const size_t textureCount = pendingTextures.size();
+	pendingTextures.clear();
+
+	// Keep the buffer non-empty so the binding is always valid
+	if (materials.empty()) {
+		materials.push_back(MaterialData{ UINT32_MAX, 0, 0, 0 });
+	}
+	if (gResources.mMaterialBuffer == 0) {
+		glGenBuffers(1, &gResources.mMaterialBuffer);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, gResources.mMaterialBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, materials.size() * sizeof(MaterialData), materials.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	spdlog::info("TEXTURE::BUILDTEXTUREARRAYS: {} new textures, {} arrays in total", textureCount, gResources.mTextureArrays.size());
 }
\ No newline at end of file
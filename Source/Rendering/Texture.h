@@ -1,14 +1,48 @@
 #ifndef TEXTURE_H
 #define TEXTURE_H
 
+#include <cstdint>
 #include <string>
 
+#include "Core/Handle.h"
+
 struct Texture {
-	unsigned int mId;
+	unsigned int mId;	// The texture array the pixels ended up in
 	std::string mType;
 	std::string mFilepath;
 };
 
+// What the render loop needs for a texture; the name and path stay in Texture
+struct GpuTexture {
+	uint32_t mArray;	// Index into gResources.mTextureArrays, UINT32_MAX until BuildTextureArrays
+	uint32_t mLayer;
+};
+
+// Every texture of one size shares a GL_TEXTURE_2D_ARRAY, one slice each
+struct TextureArray {
+	unsigned int mId;
+	int mWidth;
+	int mHeight;
+	int mLayers;
+};
+
+// One entry per GpuTexture slot, indexed by ObjectData::mMaterial (std430)
+struct MaterialData {
+	uint32_t mArray;
+	uint32_t mLayer;
+	uint32_t mFlags;
+	uint32_t pad;
+};
+
+constexpr uint32_t MATERIAL_CLAMP = 1u << 0;	// Clamp instead of repeat, arrays share one wrap mode
+
+using TextureHandle = Handle<GpuTexture>;
+
+// Decodes the image, the pixels reach the GPU in BuildTextureArrays
 void LoadTexture(const std::string& path, const std::string& name);
+TextureHandle FindTexture(const std::string& name);
+
+// Packs the textures loaded since the last call into arrays and uploads the material buffer for all of them
+void BuildTextureArrays();
 
 #endif 
\ No newline at end of file
@@ -56,10 +56,30 @@ glm::mat4 Camera::GetView() const {
     return glm::lookAt(mPosition, mPosition + mForward, mUp);
 }
 
+FrustumPlanes Camera::GetFrustumPlanes() const {
+    return ExtractFrustumPlanes(GetProjection() * GetView());
+}
+
 glm::vec3 Camera::GetPosition() const {
     return mPosition;
 }
 
+glm::vec3 Camera::GetForward() const {
+    return mForward;
+}
+
+glm::vec3 Camera::GetUp() const {
+    return mUp;
+}
+
+float Camera::GetFOV() const {
+    return mFOV;
+}
+
+float Camera::GetAspectRatio() const {
+    return mAspectRatio;
+}
+
 float Camera::GetNearPlane() const {
     return mNearPlane;
 }
@@ -78,3 +98,25 @@ void Camera::updateCameraVectors()
 
     mUp = glm::vec3(0.0f, 1.0f, 0.0f);
 }
+
+//-----------------------------------------------------------------------------
+// Gribb/Hartmann: each plane is the w row plus or minus one of the other rows
+// of the clip matrix. Normalized so distances come out in world units.
+//-----------------------------------------------------------------------------
+FrustumPlanes ExtractFrustumPlanes(const glm::mat4& viewProjection)
+{
+    const glm::mat4 rows = glm::transpose(viewProjection);
+
+    FrustumPlanes planes = {
+        rows[3] + rows[0],
+        rows[3] - rows[0],
+        rows[3] + rows[1],
+        rows[3] - rows[1],
+        rows[3] + rows[2],
+        rows[3] - rows[2]
+    };
+    for (glm::vec4& plane : planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return planes;
+}
\ No newline at end of file
@@ -1,10 +1,17 @@
 #ifndef CAMERA_H
 #define CAMERA_H
 
+#include <array>
+
 #include "Core/Math.h"
 
 class CameraController;
 
+// Left, right, bottom, top, near, far. xyz is the inward facing unit normal, w the distance
+using FrustumPlanes = std::array<glm::vec4, 6>;
+
+FrustumPlanes ExtractFrustumPlanes(const glm::mat4& viewProjection);
+
 class Camera {
 public:
     Camera(float fov = 70.0f, float aspectRatio = 1.777778f, float nearPlane = 0.1f, float farPlane = 500.0f);
@@ -22,7 +29,12 @@ public:
 
     glm::mat4 GetProjection() const;
     glm::mat4 GetView() const;
+    FrustumPlanes GetFrustumPlanes() const;
     glm::vec3 GetPosition() const;
+    glm::vec3 GetForward() const;
+    glm::vec3 GetUp() const;
+    float GetFOV() const;
+    float GetAspectRatio() const;
     float GetNearPlane() const;
     float GetFarPlane() const;
 private:
@@ -1,48 +1,84 @@
 #include "GameObject.h"
 
 #include "Log/Logger.h"
+#include "Scene/Scene.h"
 
 GameObject::GameObject(const std::string& name, const std::string& meshName, const std::string& textureName,
 	const glm::vec3& position, const glm::vec3& rotation, const glm::vec3& scale)
-	: mName(name), mMeshName(meshName), mTextureName(textureName),
-	mPosition(position), mRotation(rotation), mScale(scale)
+	: mType(ObjectType::OBJECT_TYPE_NONE), mName(name), mMeshName(meshName), mTextureName(textureName),
+	mMesh(FindMesh(meshName)), mTexture(FindTexture(textureName)),
+	mTransform(gScene.transforms.Create(position, EulerToQuat(rotation), scale))
 {}
 
 void GameObject::Print() {
 	spdlog::info("Name: {}", mName);
 	spdlog::info("Mesh Name: {}", mMeshName);
 	spdlog::info("Texture Name: {}", mTextureName);
-	spdlog::info("Position: {} {} {}", mPosition.x, mPosition.y, mPosition.z);
-	spdlog::info("Rotation: {} {} {}", mRotation.x, mRotation.y, mRotation.z);
-	spdlog::info("Scale: {} {} {}", mScale.x, mScale.y, mScale.z);
+	const glm::vec3& position = GetPosition();
+	const glm::vec3 rotation = glm::degrees(glm::eulerAngles(GetRotation()));
+	const glm::vec3& scale = GetScale();
+	spdlog::info("Position: {} {} {}", position.x, position.y, position.z);
+	spdlog::info("Rotation: {} {} {}", rotation.x, rotation.y, rotation.z);
+	spdlog::info("Scale: {} {} {}", scale.x, scale.y, scale.z);
 }
 
-ObjectType GameObject::GetStaticType()
+ObjectType GameObject::GetStaticType() const
 {
 	return mType;
 }
 
-std::string GameObject::GetMesh()
+MeshHandle GameObject::GetMesh() const
 {
-	return mMeshName;
+	return mMesh;
 }
 
-std::string GameObject::GetTexture()
+TextureHandle GameObject::GetTexture() const
 {
-	return mTextureName;
+	return mTexture;
 }
 
-glm::vec3 GameObject::GetPosition()
+uint32_t GameObject::GetTransform() const
 {
-	return mPosition;
+	return mTransform;
 }
 
-glm::vec3 GameObject::GetRotation()
+const glm::vec3& GameObject::GetPosition() const
 {
-	return mRotation;
+	return gScene.transforms.GetPosition(mTransform);
 }
 
-glm::vec3 GameObject::GetScale()
+const glm::quat& GameObject::GetRotation() const
 {
-	return mScale;
+	return gScene.transforms.GetRotation(mTransform);
 }
+
+const glm::vec3& GameObject::GetScale() const
+{
+	return gScene.transforms.GetScale(mTransform);
+}
+
+const glm::mat4& GameObject::GetWorldMatrix() const
+{
+	return gScene.transforms.GetWorldMatrix(mTransform);
+}
+
+void GameObject::SetPosition(const glm::vec3& position)
+{
+	gScene.transforms.SetPosition(mTransform, position);
+}
+
+void GameObject::SetRotation(const glm::quat& rotation)
+{
+	gScene.transforms.SetRotation(mTransform, rotation);
+}
+
+void GameObject::SetScale(const glm::vec3& scale)
+{
+	gScene.transforms.SetScale(mTransform, scale);
+}
+
+
+void GameObject::SetType(ObjectType type)
+{
+	mType = type;
+}
\ No newline at end of file
@@ -4,6 +4,8 @@
 #include <string>
 
 #include "Core/Math.h"
+#include "Rendering/Mesh.h"
+#include "Rendering/Texture.h"
 
 enum class ObjectType {
 	OBJECT_TYPE_NONE,
@@ -11,6 +13,9 @@ enum class ObjectType {
 	OBJECT_TYPE_DYNAMIC
 };
 
+// For per type render settings stored as bit masks
+inline uint32_t ObjectTypeBit(ObjectType type) { return 1u << static_cast<uint32_t>(type); }
+
 class GameObject {
 public:
 	GameObject(const std::string& name, const std::string& meshName, const std::string& textureName,
@@ -21,12 +26,19 @@ public:
 
 	void Print();
 
-	ObjectType GetStaticType();
-	std::string GetMesh();
-	std::string GetTexture();
-	glm::vec3 GetPosition();
-	glm::vec3 GetRotation();
-	glm::vec3 GetScale();
+	ObjectType GetStaticType() const;
+	MeshHandle GetMesh() const;
+	TextureHandle GetTexture() const;
+	uint32_t GetTransform() const;
+	const glm::vec3& GetPosition() const;
+	const glm::quat& GetRotation() const;
+	const glm::vec3& GetScale() const;
+	const glm::mat4& GetWorldMatrix() const;
+
+	void SetPosition(const glm::vec3& position);
+	void SetRotation(const glm::quat& rotation);
+	void SetScale(const glm::vec3& scale);
+	void SetType(ObjectType type);
 private:
 	ObjectType mType;
 
@@ -35,9 +47,10 @@ private:
 	std::string mTextureName;
 	std::string mShaderName;
 
-	glm::vec3 mPosition;
-	glm::vec3 mRotation;
-	glm::vec3 mScale;
+	MeshHandle mMesh;
+	TextureHandle mTexture;
+
+	uint32_t mTransform; // Index into gScene.transforms
 };
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,28 @@
+#ifndef LIGHT_H
+#define LIGHT_H
+
+#include <cstdint>
+
+#include "Core/Math.h"
+#include "Scene/Transform.h"
+
+enum class LightType : uint32_t {
+	LIGHT_TYPE_POINT,
+	LIGHT_TYPE_SPOT
+};
+
+// Local light, culled into view space clusters by the renderer. Position and direction
+// are in world space, or local to mTransform when the light is attached to one.
+struct Light {
+	LightType mType = LightType::LIGHT_TYPE_POINT;
+	glm::vec3 mPosition = glm::vec3(0.0f);
+	glm::vec3 mDirection = glm::vec3(0.0f, -1.0f, 0.0f);	// Spot lights only
+	glm::vec3 mColor = glm::vec3(1.0f);
+	float mIntensity = 1.0f;
+	float mRange = 10.0f;	// Attenuation reaches zero here, also the culling radius
+	float mInnerCos = 0.95f;	// Cosine of the spot cone angle where the falloff starts
+	float mOuterCos = 0.85f;	// Cosine of the spot cone angle where it ends
+	uint32_t mTransform = INVALID_TRANSFORM;
+};
+
+#endif
\ No newline at end of file
@@ -1,22 +1,88 @@
 #include "Scene.h"
 
+#include <algorithm>
+#include <cmath>
+#include <string>
+
 #include "Scene/CameraController.h"
 
-void AddObject(GameObject* object) {
+void AddObject(GameObject* object, ObjectType type) {
+	object->SetType(type);
 	object->Print();
 	gScene.objects.push_back(std::unique_ptr<GameObject>(object));
 }
 
+void AddLight(const Light& light) {
+	gScene.lights.push_back(light);
+}
+
 void CreateScene() {
 	gScene.camera = std::make_unique<Camera>();
 	gScene.camera.get()->SetController(new CameraController);
 
 	//AddObject(new GameObject("Maria", "maria", "wood"));
-	AddObject(new GameObject("Suzanne", "suzanne", "wood", glm::vec3(5.0f, 0.0f, 0.0f)));
+	AddObject(new GameObject("Suzanne", "suzanne", "wood", glm::vec3(5.0f, 0.0f, 0.0f)), ObjectType::OBJECT_TYPE_DYNAMIC);
 	AddObject(new GameObject("Cube", "cube", "brick"));
 	AddObject(new GameObject("Ground", "cube", "wood", glm::vec3(0.0f, -15.0f, 0.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(100.0f, 5.0f, 100.0f)));
+
+	Light lamp;
+	lamp.mPosition = glm::vec3(0.0f, 3.0f, 3.0f);
+	lamp.mColor = glm::vec3(1.0f, 0.8f, 0.6f);
+	lamp.mIntensity = 2.0f;
+	lamp.mRange = 12.0f;
+	AddLight(lamp);
+
+	// Follows Suzanne around
+	Light spot;
+	spot.mType = LightType::LIGHT_TYPE_SPOT;
+	spot.mPosition = glm::vec3(0.0f, 4.0f, 0.0f);
+	spot.mDirection = glm::vec3(0.0f, -1.0f, 0.0f);
+	spot.mColor = glm::vec3(0.4f, 0.6f, 1.0f);
+	spot.mIntensity = 4.0f;
+	spot.mRange = 20.0f;
+	spot.mTransform = gScene.objects[0]->GetTransform();
+	AddLight(spot);
+}
+
+// Grid of cubes in front of the camera for measuring per object costs
+void CreateBenchmarkScene(unsigned int objectCount, unsigned int lightCount) {
+	gScene.camera = std::make_unique<Camera>();
+	gScene.camera.get()->SetController(new CameraController);
+
+	const unsigned int side = static_cast<unsigned int>(std::ceil(std::sqrt(static_cast<float>(objectCount))));
+	const float spacing = 3.0f;
+	for (unsigned int i = 0; i < objectCount; i++) {
+		const float x = (static_cast<float>(i % side) - side * 0.5f) * spacing;
+		const float z = -5.0f - static_cast<float>(i / side) * spacing;
+		gScene.objects.push_back(std::make_unique<GameObject>("Cube" + std::to_string(i), "cube", (i % 2) ? "brick" : "wood", glm::vec3(x, -2.0f, z)));
+		// Mostly static like a real level, so the static shadow cache has something to save
+		gScene.objects.back()->SetType((i % 10 == 0) ? ObjectType::OBJECT_TYPE_DYNAMIC : ObjectType::OBJECT_TYPE_STATIC);
+	}
+	gScene.objects.push_back(std::make_unique<GameObject>("Ground", "cube", "wood", glm::vec3(0.0f, -15.0f, 0.0f), glm::vec3(0.0f), glm::vec3(side * spacing, 5.0f, side * spacing)));
+	gScene.objects.back()->SetType(ObjectType::OBJECT_TYPE_STATIC);
+
+	// Scattered over the same grid just above the cubes, every fourth one a spot light pointing down
+	const unsigned int lightSide = static_cast<unsigned int>(std::ceil(std::sqrt(static_cast<float>(lightCount))));
+	const float lightSpacing = lightSide > 0 ? side * spacing / lightSide : 0.0f;
+	for (unsigned int i = 0; i < lightCount; i++) {
+		Light light;
+		light.mType = (i % 4 == 3) ? LightType::LIGHT_TYPE_SPOT : LightType::LIGHT_TYPE_POINT;
+		light.mPosition = glm::vec3((static_cast<float>(i % lightSide) - lightSide * 0.5f) * lightSpacing, 1.0f, -5.0f - static_cast<float>(i / lightSide) * lightSpacing);
+		light.mColor = glm::vec3((i % 3) == 0 ? 1.0f : 0.3f, (i % 3) == 1 ? 1.0f : 0.3f, (i % 3) == 2 ? 1.0f : 0.3f);
+		light.mRange = std::max(lightSpacing * 1.5f, 4.0f);
+		AddLight(light);
+	}
 }
 
 void UpdateScene(float timestep) {
 	gScene.camera.get()->Update(timestep);
+	gScene.transforms.Update();
+
+	// Lets systems go from GetChanged() back to objects, rebuilt whenever objects were added
+	if (gScene.transformObjects.size() != gScene.transforms.Size()) {
+		gScene.transformObjects.assign(gScene.transforms.Size(), INVALID_OBJECT);
+		for (uint32_t i = 0; i < gScene.objects.size(); i++) {
+			gScene.transformObjects[gScene.objects[i]->GetTransform()] = i;
+		}
+	}
 }
\ No newline at end of file
@@ -6,14 +6,23 @@
 
 #include "Scene/GameObject.h"
 #include "Scene/Camera.h"
+#include "Scene/Light.h"
+#include "Scene/Transform.h"
+
+constexpr uint32_t INVALID_OBJECT = UINT32_MAX;
 
 struct Scene {
 	std::vector<std::unique_ptr<GameObject>> objects;
 	std::unique_ptr<Camera> camera;
+	TransformStore transforms;
+	std::vector<uint32_t> transformObjects; // Object index per transform, INVALID_OBJECT if it has none
+	std::vector<Light> lights;
 };
 
-void AddObject(GameObject* object);
+void AddObject(GameObject* object, ObjectType type = ObjectType::OBJECT_TYPE_STATIC);
+void AddLight(const Light& light);
 void CreateScene();
+void CreateBenchmarkScene(unsigned int objectCount, unsigned int lightCount = 0);
 void UpdateScene(float timestep);
 
 extern Scene gScene;
@@ -0,0 +1,94 @@
+#include "Transform.h"
+
+glm::quat EulerToQuat(const glm::vec3& degrees)
+{
+	return glm::angleAxis(glm::radians(degrees.x), glm::vec3(1.0f, 0.0f, 0.0f)) *
+		glm::angleAxis(glm::radians(degrees.y), glm::vec3(0.0f, 1.0f, 0.0f)) *
+		glm::angleAxis(glm::radians(degrees.z), glm::vec3(0.0f, 0.0f, 1.0f));
+}
+
+// translate * rotate * scale without the three full matrix multiplies
+static glm::mat4 composeMatrix(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+	const glm::mat3 rotationMatrix = glm::mat3_cast(rotation);
+
+	glm::mat4 result;
+	result[0] = glm::vec4(rotationMatrix[0] * scale.x, 0.0f);
+	result[1] = glm::vec4(rotationMatrix[1] * scale.y, 0.0f);
+	result[2] = glm::vec4(rotationMatrix[2] * scale.z, 0.0f);
+	result[3] = glm::vec4(position, 1.0f);
+	return result;
+}
+
+uint32_t TransformStore::Create(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale, uint32_t parent)
+{
+	const uint32_t transform = static_cast<uint32_t>(mPositions.size());
+
+	mPositions.push_back(position);
+	mRotations.push_back(rotation);
+	mScales.push_back(scale);
+	mParents.push_back(parent < transform ? parent : INVALID_TRANSFORM);
+	mLocalMatrices.push_back(glm::mat4(1.0f));
+	mWorldMatrices.push_back(glm::mat4(1.0f));
+	mLocalDirty.push_back(1);
+	mWorldChanged.push_back(0);
+	mAnyDirty = true;
+
+	return transform;
+}
+
+void TransformStore::SetPosition(uint32_t transform, const glm::vec3& position)
+{
+	mPositions[transform] = position;
+	markDirty(transform);
+}
+
+void TransformStore::SetRotation(uint32_t transform, const glm::quat& rotation)
+{
+	mRotations[transform] = rotation;
+	markDirty(transform);
+}
+
+void TransformStore::SetScale(uint32_t transform, const glm::vec3& scale)
+{
+	mScales[transform] = scale;
+	markDirty(transform);
+}
+
+void TransformStore::Update()
+{
+	mChanged.clear();
+	if (!mAnyDirty) {
+		return;
+	}
+
+	const size_t count = mPositions.size();
+	for (size_t i = 0; i < count; i++) {
+		const uint32_t parent = mParents[i];
+		const bool parentChanged = parent != INVALID_TRANSFORM && mWorldChanged[parent];
+
+		if (mLocalDirty[i]) {
+			mLocalMatrices[i] = composeMatrix(mPositions[i], mRotations[i], mScales[i]);
+			mLocalDirty[i] = 0;
+		}
+		else if (!parentChanged) {
+			continue;
+		}
+
+		mWorldMatrices[i] = parent != INVALID_TRANSFORM ? mWorldMatrices[parent] * mLocalMatrices[i] : mLocalMatrices[i];
+		mWorldChanged[i] = 1;
+		mChanged.push_back(static_cast<uint32_t>(i));
+	}
+
+	// Changed flags only have to live through the sweep above
+	for (uint32_t transform : mChanged) {
+		mWorldChanged[transform] = 0;
+	}
+	mAnyDirty = false;
+}
+
+void TransformStore::markDirty(uint32_t transform)
+{
+	mLocalDirty[transform] = 1;
+	mAnyDirty = true;
+}
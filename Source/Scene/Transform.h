@@ -0,0 +1,61 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Core/Math.h"
+
+constexpr uint32_t INVALID_TRANSFORM = UINT32_MAX;
+
+// Builds the rotation the old euler path produced: rotate X, then Y, then Z (degrees)
+glm::quat EulerToQuat(const glm::vec3& degrees);
+
+//---------------------------------------------------------------------------------
+// Stores every transform in the scene as parallel arrays. Rotation is kept as a
+// quaternion and local/world matrices are cached; setters only mark a transform
+// dirty and Update() recomputes what changed. World matrices sit in one
+// contiguous array so the renderer can read them without touching game objects.
+//
+// Parents must be created before their children, which lets Update() resolve
+// the hierarchy in a single forward sweep.
+//---------------------------------------------------------------------------------
+class TransformStore {
+public:
+	uint32_t Create(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale, uint32_t parent = INVALID_TRANSFORM);
+
+	void SetPosition(uint32_t transform, const glm::vec3& position);
+	void SetRotation(uint32_t transform, const glm::quat& rotation);
+	void SetScale(uint32_t transform, const glm::vec3& scale);
+
+	const glm::vec3& GetPosition(uint32_t transform) const { return mPositions[transform]; }
+	const glm::quat& GetRotation(uint32_t transform) const { return mRotations[transform]; }
+	const glm::vec3& GetScale(uint32_t transform) const { return mScales[transform]; }
+	const glm::mat4& GetLocalMatrix(uint32_t transform) const { return mLocalMatrices[transform]; }
+	const glm::mat4& GetWorldMatrix(uint32_t transform) const { return mWorldMatrices[transform]; }
+
+	// Recomputes dirty local matrices and any world matrix whose local or parent changed
+	void Update();
+
+	const std::vector<glm::mat4>& GetWorldMatrices() const { return mWorldMatrices; }
+	// Transforms whose world matrix changed during the last Update()
+	const std::vector<uint32_t>& GetChanged() const { return mChanged; }
+	size_t Size() const { return mPositions.size(); }
+private:
+	void markDirty(uint32_t transform);
+
+	std::vector<glm::vec3> mPositions;
+	std::vector<glm::quat> mRotations;
+	std::vector<glm::vec3> mScales;
+	std::vector<uint32_t> mParents;
+
+	std::vector<glm::mat4> mLocalMatrices;
+	std::vector<glm::mat4> mWorldMatrices;
+
+	std::vector<uint8_t> mLocalDirty;
+	std::vector<uint8_t> mWorldChanged;
+	std::vector<uint32_t> mChanged;
+	bool mAnyDirty = false;
+};
+
+#endif